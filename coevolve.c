@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "coevolve.h"
+#include "micro-ga.h"
+#include "parallel.h"
+
+typedef struct coevolve_s coevolve_t;
+
+/* Sub-population evolving the split of one group of loans */
+typedef struct
+{
+	coevolve_t* co;
+	unsigned int* members;			/// Loans of the group
+	unsigned int size;
+	double surplus;					/// Group's share of the budget above the floors
+	double start_total;				/// What the group's loans cost at the start of the epoch
+	micro_ga_t ga;
+} group_t;
+
+struct coevolve_s
+{
+	coevolve_config_t* config;
+	loan_terms_t* terms;			/// Constants of every loan's cost
+	unsigned int num_loans;
+	double* floor;					/// Smallest payment of each loan
+	double* best;					/// Best split so far, combined from every group
+	group_t* groups;
+	unsigned int num_groups;
+	unsigned int failed;
+};
+
+// Local functions
+static void group_fitness(micro_ga_genome_t* individuals, unsigned int count, void* user_data);
+static double group_payments(group_t* group, const float* genes, double* payments);
+static int group_init(group_t* group);
+static void run_groups(void* ctx, unsigned long int begin, unsigned long int end);
+
+int coevolve_optimize(coevolve_config_t* config, loan_t* loans, unsigned int num_loans,
+					  double budget, float* payments, double* total)
+{
+	coevolve_t co;
+	unsigned int* perm;
+	unsigned int l, g, k, epoch, t;
+	double floors, principal, interest;
+	int status = 0;
+
+	// Check required parameters
+	if(config == NULL || loans == NULL || payments == NULL || total == NULL)
+		return -1;
+	if(num_loans == 0 || config->group_size == 0 || config->population_size < 2 || config->epochs == 0)
+		return -2;
+
+	memset(&co, 0, sizeof(coevolve_t));
+	co.config = config;
+	co.num_loans = num_loans;
+	co.num_groups = (num_loans + config->group_size - 1) / config->group_size;
+
+	co.floor  = (double*)malloc(sizeof(double) * num_loans * 2);
+	co.terms  = (loan_terms_t*)malloc(sizeof(loan_terms_t) * num_loans);
+	co.groups = (group_t*)calloc(co.num_groups, sizeof(group_t));
+	perm      = (unsigned int*)malloc(sizeof(unsigned int) * num_loans);
+	if(co.floor == NULL || co.terms == NULL || co.groups == NULL || perm == NULL) {
+		free(co.floor);
+		free(co.terms);
+		free(co.groups);
+		free(perm);
+		return -1;
+	}
+	co.best = co.floor + num_loans;
+
+	// Floors keep every loan payable, whatever the genes
+	floors = 0;
+	principal = 0;
+	for(l = 0; l < num_loans; l++) {
+		loan_terms(&loans[l], &co.terms[l]);
+		interest = co.terms[l].interest;
+		co.floor[l] = (loans[l].min_payment > interest + 0.01 ? loans[l].min_payment : interest + 0.01);
+		floors += co.floor[l];
+		principal += loans[l].principal;
+		perm[l] = l;
+	}
+	if(floors > budget) {
+		free(co.floor);
+		free(co.terms);
+		free(co.groups);
+		free(perm);
+		return -2;
+	}
+
+	// Start with the rest split by principal
+	for(l = 0; l < num_loans; l++)
+		co.best[l] = co.floor[l] + (budget - floors) * loans[l].principal / principal;
+
+	for(epoch = 0; epoch < config->epochs && status == 0; epoch++)
+	{
+		// Deal the loans into new groups
+		for(l = num_loans - 1; l > 0; l--) {
+			k = rand() % (l + 1);
+			t = perm[l]; perm[l] = perm[k]; perm[k] = t;
+		}
+
+		for(g = 0; g < co.num_groups && status == 0; g++) {
+			co.groups[g].co = &co;
+			co.groups[g].members = &perm[g * config->group_size];
+			co.groups[g].size = (g + 1 < co.num_groups ? config->group_size :
+								 num_loans - g * config->group_size);
+			status = group_init(&co.groups[g]);
+			if(status != 0) {
+				while(g-- > 0)
+					micro_ga_destroy(&co.groups[g].ga);
+			}
+		}
+		if(status != 0)
+			break;
+
+		// Groups own disjoint loans, so they write their best splits independently
+		parallel_for(config->num_threads, co.num_groups, &run_groups, &co);
+
+		for(g = 0; g < co.num_groups; g++)
+			micro_ga_destroy(&co.groups[g].ga);
+	}
+
+	*total = 0;
+	for(l = 0; l < num_loans; l++) {
+		payments[l] = co.best[l];
+		*total += loan_total_paid(&co.terms[l], co.best[l]);
+	}
+
+	free(co.floor);
+	free(co.terms);
+	free(co.groups);
+	free(perm);
+
+	return (status != 0 || co.failed ? -1 : 0);
+}
+
+/* Start a group's GA from the current best split of its loans */
+static int group_init(group_t* group)
+{
+	coevolve_t* co = group->co;
+	coevolve_config_t* config = co->config;
+	unsigned int k, l, n;
+	double budget = 0;
+	float *genes, *jitter, largest;
+
+	for(k = 0; k < group->size; k++) {
+		l = group->members[k];
+		budget += co->best[l];
+		budget -= co->floor[l];
+	}
+	group->surplus = (budget > 0 ? budget : 0);
+
+	micro_ga_config_t ga_config =
+	{
+		.population_size  = config->population_size,
+		.genome_size      = group->size,
+		.mutation_rate    = config->mutation_rate,
+		.crossover_rate   = config->crossover_rate,
+		.fitness_thresh   = 0,
+		.fitness_fn       = NULL,
+		.acceptance_fn    = NULL,
+		.batch_fitness_fn = &group_fitness,
+		.user_data        = group
+	};
+	if(micro_ga_init(&group->ga, &ga_config) != 0)
+		return -1;
+
+	genes = (float*)malloc(sizeof(float) * group->size * 2);
+	if(genes == NULL) {
+		micro_ga_destroy(&group->ga);
+		return -1;
+	}
+	jitter = genes + group->size;
+
+	// Genes proportional to each loan's share reproduce the best split, scaled
+	// so the largest is just below one
+	largest = 0;
+	for(k = 0; k < group->size; k++) {
+		l = group->members[k];
+		genes[k] = (co->best[l] > co->floor[l] ? co->best[l] - co->floor[l] : 0);
+		if(genes[k] > largest)
+			largest = genes[k];
+	}
+	for(k = 0; k < group->size; k++)
+		genes[k] = (largest > 0 ? genes[k] * 0.9999f / largest : 0.5f);
+	group->start_total = group_payments(group, genes, NULL);
+	micro_ga_set_genes(&group->ga, 0, genes);
+
+	// The rest of the population explores around it
+	for(n = 1; n < config->population_size; n++) {
+		for(k = 0; k < group->size; k++) {
+			jitter[k] = genes[k] * (0.9f + 0.2f * rand() / ((float)RAND_MAX + 1));
+			if(jitter[k] > 0.9999f)
+				jitter[k] = 0.9999f;
+		}
+		micro_ga_set_genes(&group->ga, n, jitter);
+	}
+	free(genes);
+
+	return 0;
+}
+
+static void run_groups(void* ctx, unsigned long int begin, unsigned long int end)
+{
+	coevolve_t* co = (coevolve_t*)ctx;
+	group_t* group;
+	micro_ga_t* ga;
+	unsigned long int g;
+	unsigned int n, k, best;
+	double* payments;
+
+	payments = (double*)malloc(sizeof(double) * co->config->group_size);
+	if(payments == NULL) {
+		__sync_fetch_and_add(&co->failed, 1);
+		return;
+	}
+
+	for(g = begin; g < end; g++)
+	{
+		group = &co->groups[g];
+		ga = &group->ga;
+		for(n = 0; n < co->config->generations; n++)
+			micro_ga_evolve(ga);
+
+		// Children of the last evolution still need their fitness
+		micro_ga_evaluate(ga);
+		best = ga->best;
+
+		// Decoding rounds, so never give back a worse split than the group got
+		if(group_payments(group, ga->individuals[best].genes, payments) < group->start_total) {
+			for(k = 0; k < group->size; k++)
+				co->best[ group->members[k] ] = payments[k];
+		}
+	}
+
+	free(payments);
+}
+
+/* Fitness is the inverse of what the group's loans cost, the other groups don't change */
+static void group_fitness(micro_ga_genome_t* individuals, unsigned int count, void* user_data)
+{
+	group_t* group = (group_t*)user_data;
+	unsigned int n;
+	double total;
+
+	for(n = 0; n < count; n++) {
+		total = group_payments(group, individuals[n].genes, NULL);
+		individuals[n].fitness = (isfinite(total) ? 1.0 / total : 1e-10);
+	}
+}
+
+/* Decode genes into payments (if not NULL), return the group's total paid */
+static double group_payments(group_t* group, const float* genes, double* payments)
+{
+	coevolve_t* co = group->co;
+	unsigned int k, l;
+	double wsum = 0, p, total = 0;
+
+	for(k = 0; k < group->size; k++)
+		wsum += genes[k];
+
+	for(k = 0; k < group->size; k++)
+	{
+		l = group->members[k];
+		p = co->floor[l] + group->surplus * (wsum > 0 ? genes[k] / wsum : 1.0 / group->size);
+		if(payments != NULL)
+			payments[k] = p;
+		total += loan_total_paid(&co->terms[l], p);
+	}
+
+	return total;
+}
@@ -0,0 +1,46 @@
+#ifndef COEVOLVE_H_
+#define COEVOLVE_H_
+
+#include "loan.h"
+
+/*
+ * Cooperative coevolution of the payment split for very large portfolios.
+ * Loans are dealt into random groups and every group evolves the split of
+ * its share of the budget in its own micro GA, one thread per group at a
+ * time. After every epoch the best split of each group is combined, loans
+ * are dealt into new groups and each group's share of the budget becomes
+ * what the combined split pays its loans, so money moves between loans of
+ * different groups over the epochs.
+ *
+ * Within a group, every loan gets its floor (the larger of .min_payment and
+ * a cent above its monthly interest), and the rest of the group's share is
+ * split in proportion to the genes.
+ */
+typedef struct
+{
+	unsigned int group_size;		/// Loans per group
+	unsigned int population_size;	/// Individuals per group
+	unsigned int generations;		/// Generations per epoch
+	unsigned int epochs;			/// # of times loans are regrouped
+	float mutation_rate;			/// About 1 / group_size, mutated genes are redrawn
+	float crossover_rate;
+	unsigned int num_threads;		/// 0 = one per CPU
+} coevolve_config_t;
+
+
+/**
+ *  Optimize the monthly payment of every loan, paying budget in total.
+ *
+ *  @param config
+ *  @param loans
+ *  @param num_loans
+ *  @param budget Total monthly payment
+ *  @param payments Output, num_loans monthly payments
+ *  @param total Output, total paid
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ *          -2 = invalid configuration, or the budget doesn't cover every floor
+ */
+int coevolve_optimize(coevolve_config_t* config, loan_t* loans, unsigned int num_loans,
+					  double budget, float* payments, double* total);
+
+#endif
@@ -16,7 +16,17 @@
 #include <math.h>
 #include <assert.h>
 #include <time.h>
+#include <string.h>
 #include "micro-ga.h"
+#include "trace.h"
+#include "loan.h"
+#include "scenario.h"
+#include "schedule.h"
+#include "payoff.h"
+#include "payoff-search.h"
+#include "sim-anneal.h"
+#include "race.h"
+#include "coevolve.h"
 
 
 /* Total amount per month you are willing to pay */
@@ -30,15 +40,14 @@
 #define PAYMENT_DEVIATION		0.0
 
 
-typedef struct {
-	float interest_rate;
-	float principal;
-} loan_t;
-
 /* Number of loans defined in the struct below */
 #define NUM_LOANS	3
 
-/* Loan data. Only require the interest rate and the initial principal amount */
+/* 
+ * Loan data. Only require the interest rate and the initial principal amount.
+ * For a variable rate loan, also set .rate_volatility to the expected yearly
+ * swing of its rate in percent points (see ROBUST_SCENARIOS below).
+ */
 loan_t loans[NUM_LOANS] = 
 {
 	// Loan 1
@@ -65,17 +74,231 @@ loan_t loans[NUM_LOANS] =
  */
 #define POP_SIZE 			15
 
+/*
+ * Plans costing over 30% more than the minimum possible total are replaced
+ * every generation. Once there are fewer than this many, the worst this many
+ * are replaced anyway, and the others survive without being evaluated again.
+ */
+#define MIN_REPLACE			(POP_SIZE / 2)
+
+/*
+ * Crossover used on payment splits and schedules: MICRO_GA_BLEND, MICRO_GA_SBX,
+ * MICRO_GA_BLX, MICRO_GA_ARITHMETIC, MICRO_GA_ONE_POINT, MICRO_GA_TWO_POINT or
+ * MICRO_GA_UNIFORM. SPLIT_CROSSOVER_PARAM is SBX's eta or BLX's alpha, zero
+ * for the default. Compact genes are always blended.
+ */
+#define SPLIT_CROSSOVER			MICRO_GA_BLEND
+#define SPLIT_CROSSOVER_PARAM	0.0
+
+/*
+ * To start payment splits and schedules from a Latin hypercube instead of
+ * independent random genes, define to non-zero value. Every gene then takes
+ * each 1/POP_SIZE slice of its range in one individual, so even a small
+ * population starts spread over every way of splitting the payment.
+ */
+#define LATIN_INIT				1
+
+/*
+ * Number of simulated interest rate paths per loan. If non-zero, payment plans
+ * are judged by their cost over all paths instead of at today's rates, which
+ * favours plans that stay cheap when variable rates move. Use zero to only
+ * evaluate at the loans' current rates.
+ */
+#define ROBUST_SCENARIOS	0
+
+/* Months simulated per rate path */
+#define ROBUST_HORIZON		360
+
+/*
+ * Blend between the expected cost (0.0) and the cost of the worst 5% of rate
+ * paths (1.0) when judging a plan.
+ */
+#define ROBUST_TAIL_WEIGHT	0.25
+
+/*
+ * Number of rate paths every plan of a generation is first evaluated on. Only
+ * the best quarter of the plans move on to four times as many paths, and so
+ * on until the leaders have seen all ROBUST_SCENARIOS paths. Use zero to
+ * evaluate every plan on every path.
+ */
+#define ROBUST_RACE_INITIAL	64
+
+/*
+ * Months per period of a time-varying payment schedule. If non-zero, the GA
+ * optimizes a separate split of the monthly payment for every period over
+ * SCHEDULE_YEARS (1 = monthly, 3 = quarterly, 12 = yearly) instead of one
+ * split for the life of the loans. Each loan gets its .min_payment first, the
+ * rest of the budget is split by the schedule. Use zero for one fixed split.
+ */
+#define SCHEDULE_PERIOD_MONTHS	0
+
+/* Length of a time-varying schedule or payoff order simulation */
+#define SCHEDULE_YEARS		30
+
+/* Yearly growth of the monthly budget in percent, e.g. for expected raises */
+#define SCHEDULE_BUDGET_GROWTH	0.0
+
+/*
+ * To optimize a schedule coarse to fine, define to non-zero value. The GA
+ * first optimizes yearly periods, then refines its population to quarterly
+ * and finally to SCHEDULE_PERIOD_MONTHS periods. MAX_ITERATIONS is shared
+ * between the levels.
+ */
+#define SCHEDULE_MULTIRES	1
+
+/*
+ * To search for the best payoff order instead of splitting the payment, define
+ * to non-zero value. Every month each loan gets its .min_payment and the rest
+ * of PAYMENT_NOMINAL goes to the first loan in the order which isn't paid off
+ * yet, so payments of paid off loans go to the remaining ones.
+ */
+#define OPTIMIZE_ORDER		0
+
+/* Crossover used on payoff orders, MICRO_GA_OX or MICRO_GA_PMX */
+#define ORDER_CROSSOVER		MICRO_GA_OX
+
+/*
+ * To also find the provably best payoff order by trying every order, define
+ * to non-zero value. Only done for up to PAYOFF_ENUMERATE_MAX loans; 11 loans
+ * take a few seconds per core. Larger portfolios are searched by branch and
+ * bound, starting from the GA's best order.
+ */
+#define ORDER_EXHAUSTIVE	1
+
+/*
+ * Seconds the branch and bound search may take. If it runs out, the best
+ * order found is printed along with how far from optimal it can be.
+ */
+#define ORDER_TIME_LIMIT	10.0
+
+/*
+ * To split the payment by simulated annealing instead of the GA, define to
+ * the number of moves. Each move shifts part of one loan's payment to another
+ * and only re-evaluates those two loans, so millions of moves take about a
+ * second. Uses today's rates and PAYMENT_NOMINAL only.
+ */
+#define ANNEAL_MOVES		0
+
+/*
+ * To run the GA, simulated annealing and a local search at the same time and
+ * keep the best split any of them finds, define to the number of seconds they
+ * may take. Engines falling too far behind the leader are stopped early.
+ */
+#define RACE_DEADLINE		0.0
+
+/*
+ * Number of evaluated genomes remembered, so clones aren't evaluated again.
+ * Splits within a cent of each other count as clones. Not used with racing,
+ * where a plan's score depends on the plans it raced against. Use zero to
+ * evaluate every individual.
+ */
+#define DEDUP_SIZE			1024
+
+/*
+ * Children bred per replaced individual. If above one, a model of the fitness
+ * over recently evaluated plans picks the most promising children and only
+ * those are evaluated, which pays off when evaluations are expensive (rate
+ * paths, monthly schedules). Use zero to evaluate every child.
+ */
+#define SURROGATE_RATIO		0
+
+/*
+ * For portfolios with thousands of loans, define to the number of loans per
+ * group. Loans are dealt into random groups which each evolve their part of
+ * the split on their own thread, MAX_ITERATIONS generations per epoch, and
+ * are dealt again after every epoch. Uses today's rates and PAYMENT_NOMINAL.
+ */
+#define COEVOLVE_GROUP_SIZE	0
+
+/* Number of times loans are dealt into new groups */
+#define COEVOLVE_EPOCHS		20
+
+/*
+ * To split the payment in whole cents, define to non-zero value. Every plan
+ * adds up to PAYMENT_NOMINAL exactly, and loans are amortized month by month
+ * with interest rounded to the cent, as a lender would. Loans must be paid
+ * off within SCHEDULE_YEARS. Uses today's rates and PAYMENT_NOMINAL only.
+ */
+#define EXACT_CENTS			0
+
+/*
+ * To store genes as 16-bit fixed point instead of floats, define to non-zero
+ * value. Halves the memory large populations and long schedules move while
+ * breeding, and a gene still resolves the payment to better than 2 cents.
+ */
+#define COMPACT_GENES		0
+
 /* To print out extra debug-level messages, define to non-zero value */
 #define VERBOSE				0
 
+/*
+ * Trace level of the GA: TRACE_LEVEL_GENERATION, TRACE_LEVEL_INDIVIDUAL,
+ * TRACE_LEVEL_GENE or 0 for none. Events are written to TRACE_FILE, which
+ * trace-decode prints. Only levels built in with make TRACE_LEVEL=... are
+ * recorded.
+ */
+#define GA_TRACE			0
+#define TRACE_FILE			"loan-optimize.trace"
+
 
 /* Locals */
 void eval_fitness(micro_ga_genome_t* individual);
-float num_payments(loan_t* loan, double monthly_payment);
-float total_paid(loan_t* loan, double monthly_payment);
+void eval_fitness_batch(micro_ga_genome_t* individuals, unsigned int count, void* user_data);
+void eval_schedule_fitness(micro_ga_genome_t* individual);
+unsigned int payments_feasible(float* payments);
 unsigned int eval_acceptance(micro_ga_genome_t* individual);
 void genome_to_payments(micro_ga_genome_t* individual, float* payments);
 void print_info(micro_ga_t* ga);
+void print_schedule_info(micro_ga_t* ga);
+void optimize_split(float fitness_thresh);
+void optimize_schedule(float fitness_thresh);
+void optimize_order(float fitness_thresh);
+void eval_order_fitness(micro_ga_genome_t* individual);
+void print_order_info(micro_ga_t* ga);
+const float* schedule_genes(micro_ga_genome_t* individual);
+void optimize_cents(float fitness_thresh);
+void eval_cents_fitness(micro_ga_genome_t* individual);
+void optimize_anneal(void);
+double eval_anneal_cost(unsigned int index, double value, void* user_data);
+void init_anneal(sim_anneal_t* sa, unsigned long int moves, double temp);
+void optimize_race(void);
+void optimize_coevolve(void);
+unsigned int race_ga_step(void* engine);
+double race_ga_best(void* engine, double* solution);
+unsigned int race_anneal_step(void* engine);
+double race_anneal_best(void* engine, double* solution);
+
+/*
+ * Evaluation state kept with every split (see micro_ga_config_t.cache_size).
+ * With the stick-breaking encoding a changed gene changes the payments of its
+ * loan and every later one, but e.g. the loans before a mutation keep theirs.
+ */
+typedef struct
+{
+	float payments[NUM_LOANS];		/// Payments the costs were computed for
+	float costs[NUM_LOANS];			/// Total paid on each loan
+} split_cache_t;
+
+/* Same for plans in whole cents (EXACT_CENTS) */
+typedef struct
+{
+	unsigned int payments[NUM_LOANS];
+	long long int costs[NUM_LOANS];
+} cents_cache_t;
+
+/* Constants of every loan's cost, computed once so evaluations skip them */
+loan_terms_t terms[NUM_LOANS];
+
+/* Simulated rate paths, shared by all evaluations (ROBUST_SCENARIOS) */
+scenario_set_t scenarios;
+unsigned long int scenario_evaluations = 0;
+
+/* Time-varying schedule being optimized (SCHEDULE_PERIOD_MONTHS) */
+schedule_t schedule;
+float* compact_genes = NULL;		/// COMPACT_GENES converted back to floats
+
+/* Payoff order simulator (OPTIMIZE_ORDER) */
+payoff_t payoff;
 
 int main(int argc, char* argv[])
 {
@@ -85,15 +308,72 @@ int main(int argc, char* argv[])
 
 	srand(time(NULL));
 
+	if(GA_TRACE && trace_open(TRACE_FILE) != 0)
+		printf("Can't write %s, not tracing\n", TRACE_FILE);
+
 	// Get minimum possible payment
 	float minimum_total_payment = 0;
 	unsigned int i;
 	for(i = 0; i < NUM_LOANS; i++) {
 		minimum_total_payment += loans[i].principal;
+		loan_terms(&loans[i], &terms[i]);
 	}
 	printf("Minimum possible total payment: $%.2f\n", minimum_total_payment);
 	printf("\n");
 
+	// Rate paths are drawn once so every plan sees the same ones
+	if(ROBUST_SCENARIOS)
+	{
+		scenario_config_t scenario_config =
+		{
+			.num_scenarios = ROBUST_SCENARIOS,
+			.horizon       = ROBUST_HORIZON,
+			.reversion     = 0.02,
+			.correlation   = 0.8,
+			.tail_level    = 0.95,
+			.num_threads   = 0,
+			.seed          = rand()
+		};
+		assert( scenario_init(&scenarios, &scenario_config, loans, NUM_LOANS) == 0 );
+	}
+
+	// Time-varying schedules have their own driver
+	if(SCHEDULE_PERIOD_MONTHS)
+		optimize_schedule(1.0 / (minimum_total_payment * 1.30));
+
+	// So does cooperative coevolution
+	else if(COEVOLVE_GROUP_SIZE)
+		optimize_coevolve();
+
+	// And races of several engines
+	else if(RACE_DEADLINE > 0)
+		optimize_race();
+
+	// And annealing
+	else if(ANNEAL_MOVES)
+		optimize_anneal();
+
+	// And plans in whole cents
+	else if(EXACT_CENTS)
+		optimize_cents(1.0 / (minimum_total_payment * 1.30));
+
+	// And payoff orders
+	else if(OPTIMIZE_ORDER)
+		optimize_order(1.0 / (minimum_total_payment * 1.30));
+
+	// Otherwise split one monthly payment between the loans
+	else
+		optimize_split(1.0 / (minimum_total_payment * 1.30));
+
+	if(ROBUST_SCENARIOS)
+		scenario_destroy(&scenarios);
+
+	return 0;
+}
+
+/* Split one monthly payment between the loans */
+void optimize_split(float fitness_thresh)
+{
 	// GA config
 	micro_ga_t ga;
 	micro_ga_config_t config = 
@@ -102,42 +382,171 @@ int main(int argc, char* argv[])
 		.genome_size     = NUM_LOANS,
 		.mutation_rate   = 0.1,
 		.crossover_rate  = 0.7,
-		.fitness_thresh  = 1.0 / (minimum_total_payment * 1.30),
+		.fitness_thresh  = fitness_thresh,
+		.min_replace     = MIN_REPLACE,
+		.crossover       = (COMPACT_GENES ? MICRO_GA_BLEND : SPLIT_CROSSOVER),
+		.crossover_param = SPLIT_CROSSOVER_PARAM,
+		.genome_type     = (COMPACT_GENES ? MICRO_GA_REAL16 : MICRO_GA_REAL),
+		.init_sampling   = (LATIN_INIT ? MICRO_GA_LATIN_INIT : MICRO_GA_RANDOM_INIT),
 		.fitness_fn      = &eval_fitness,
 		.acceptance_fn   = NULL,
-		.debug           = (VERBOSE ? 1 : 0)
+		.batch_fitness_fn = (ROBUST_SCENARIOS && ROBUST_RACE_INITIAL ? &eval_fitness_batch : NULL),
+		.user_data       = NULL,
+		.cache_size      = sizeof(split_cache_t),
+		.dedup_size      = (ROBUST_SCENARIOS && ROBUST_RACE_INITIAL ? 0 : DEDUP_SIZE),
+		.dedup_quantum   = 0.01 / PAYMENT_NOMINAL,
+		.surrogate_ratio = (COMPACT_GENES ? 0 : SURROGATE_RATIO),
+		.surrogate_max_error = 0.05,
+		.debug           = GA_TRACE
 	};
 
 	// Init the GA
 	assert( micro_ga_init(&ga, &config) == 0 );
 
-	unsigned int n = 0, m = 0;
-	float best_fitness;
-	float fitness;
-	unsigned int best_individual;
+	unsigned int n = 0;
 	do
 	{
 		micro_ga_evolve(&ga);
+	} while(++n < MAX_ITERATIONS);
+
+	// Children of the last evolution still need their fitness
+	micro_ga_evaluate(&ga);
+
+	// Done, print results
+	micro_ga_sort(&ga);
+	print_info(&ga);
 
-		best_fitness = 0.0;
-		for(m = 0; m < ga.population_size; m++)
+	if(ROBUST_SCENARIOS && ROBUST_RACE_INITIAL) {
+		printf("Path evaluations: %lu (%lu without racing)\n", scenario_evaluations,
+			   (unsigned long int)(MAX_ITERATIONS + 1) * POP_SIZE * ROBUST_SCENARIOS);
+	}
+
+	if(VERBOSE) {
+		printf("Duplicate evaluations skipped: %lu\n", ga.dedup_hits);
+		if(SURROGATE_RATIO > 1)
+			printf("Children screened out: %lu (prediction error %.2f%%)\n",
+				   ga.surrogate_screened, ga.surrogate_error * 100.0);
+	}
+
+	// Destroy GA
+	micro_ga_destroy(&ga);
+}
+
+/*
+ * Optimize a time-varying schedule. With SCHEDULE_MULTIRES, yearly and then
+ * quarterly schedules are optimized first. Their genomes are short, so they
+ * converge in few generations, and each finer level starts from the coarser
+ * level's population instead of from random schedules.
+ */
+void optimize_schedule(float fitness_thresh)
+{
+	unsigned int levels[3], num_levels = 0, level, generations, i, n;
+	unsigned int months = SCHEDULE_YEARS * 12;
+	unsigned int target = SCHEDULE_PERIOD_MONTHS;
+	unsigned long int genome_size;
+	float *budget, *seed = NULL, *genes = NULL;
+	schedule_t coarse;
+	micro_ga_t ga;
+
+	// Coarser levels must evenly divide into the finer ones
+	if(SCHEDULE_MULTIRES && target < 12 && 12 % target == 0)
+		levels[num_levels++] = 12;
+	if(SCHEDULE_MULTIRES && target < 3 && 3 % target == 0)
+		levels[num_levels++] = 3;
+	levels[num_levels++] = target;
+
+	// Budget for every month
+	budget = (float*)malloc(sizeof(float) * months);
+	assert(budget != NULL);
+	for(i = 0; i < months; i++)
+		budget[i] = PAYMENT_NOMINAL * pow(1.0 + SCHEDULE_BUDGET_GROWTH / 100.0, i / 12);
+
+	generations = MAX_ITERATIONS / num_levels;
+	if(generations == 0)
+		generations = 1;
+
+	for(level = 0; level < num_levels; level++)
+	{
+		assert( schedule_init(&schedule, loans, NUM_LOANS, months / levels[level],
+							  levels[level], budget) == 0 );
+		genome_size = schedule_genome_size(&schedule);
+
+		// Mutate as many genes per child as a single split would
+		micro_ga_config_t config = 
 		{
-			eval_fitness(&(ga.individuals[m]));
-			fitness = ga.individuals[m].fitness;
-			if(fitness > best_fitness) {
-				best_fitness = fitness;
-				best_individual = m;
+			.population_size = POP_SIZE,
+			.genome_size     = genome_size,
+			.mutation_rate   = 0.1 * NUM_LOANS / genome_size,
+			.crossover_rate  = 0.7,
+			.fitness_thresh  = fitness_thresh,
+			.min_replace     = MIN_REPLACE,
+			.crossover       = (COMPACT_GENES ? MICRO_GA_BLEND : SPLIT_CROSSOVER),
+			.crossover_param = SPLIT_CROSSOVER_PARAM,
+			.fitness_fn      = &eval_schedule_fitness,
+			.acceptance_fn   = NULL,
+			.cache_size      = schedule_cache_size(&schedule),
+			.genome_type     = (COMPACT_GENES ? MICRO_GA_REAL16 : MICRO_GA_REAL),
+			.init_sampling   = (LATIN_INIT ? MICRO_GA_LATIN_INIT : MICRO_GA_RANDOM_INIT),
+			.dedup_size      = DEDUP_SIZE,
+			.surrogate_ratio = (COMPACT_GENES ? 0 : SURROGATE_RATIO),
+			.surrogate_max_error = 0.05,
+			.debug           = GA_TRACE
+		};
+		assert( micro_ga_init(&ga, &config) == 0 );
+
+		if(COMPACT_GENES) {
+			free(compact_genes);
+			compact_genes = (float*)malloc(sizeof(float) * genome_size);
+			assert(compact_genes != NULL);
+		}
+
+		// Start from the coarser level's population
+		if(seed != NULL)
+		{
+			genes = (float*)malloc(sizeof(float) * genome_size);
+			assert(genes != NULL);
+			for(n = 0; n < POP_SIZE; n++) {
+				assert( schedule_upsample(&coarse, &seed[n * schedule_genome_size(&coarse)], &schedule, genes) == 0 );
+				assert( micro_ga_set_genes(&ga, n, genes) == 0 );
 			}
+			free(genes);
+			free(seed);
+			schedule_destroy(&coarse);
 		}
 
-	} while(++n < MAX_ITERATIONS);
+		n = 0;
+		do
+		{
+			micro_ga_evolve(&ga);
+		} while(++n < generations);
+
+		// Children of the last evolution still need their fitness
+		micro_ga_evaluate(&ga);
+		micro_ga_sort(&ga);
+
+		printf("%2u month periods: best total paid $%.2f\n", levels[level],
+			   1.0 / ga.individuals[POP_SIZE - 1].fitness);
+
+		// Keep the population for the next level
+		if(level + 1 < num_levels)
+		{
+			seed = (float*)malloc(sizeof(float) * genome_size * POP_SIZE);
+			assert(seed != NULL);
+			for(n = 0; n < POP_SIZE; n++)
+				micro_ga_get_genes(&ga, n, &seed[n * genome_size]);
+			coarse = schedule;
+			micro_ga_destroy(&ga);
+		}
+	}
+	printf("\n");
 
 	// Done, print results
-	micro_ga_sort(&ga);
-	print_info(&ga);
+	print_schedule_info(&ga);
 
-	// Destroy GA
 	micro_ga_destroy(&ga);
+	schedule_destroy(&schedule);
+	free(compact_genes);
+	free(budget);
 }
 
 /*
@@ -147,6 +556,7 @@ int main(int argc, char* argv[])
  */
 void eval_fitness(micro_ga_genome_t* individual)
 {
+	split_cache_t* cache = (split_cache_t*)individual->cache;
 	float f = 0.0, p = 0.0, n = 0.0;
 	float payments[NUM_LOANS];
 
@@ -159,14 +569,24 @@ void eval_fitness(micro_ga_genome_t* individual)
 	unsigned int i;
 	for(i = 0; i < NUM_LOANS; i++)
 	{
-		p = total_paid( &(loans[i]), payments[i] );
-		n = num_payments( &(loans[i]), payments[i] );
+		// Only loans whose payment changed are evaluated again. A fresh
+		// individual (first_changed = 0) has nothing cached yet.
+		if(cache != NULL && individual->first_changed > 0 && cache->payments[i] == payments[i]) {
+			p = n = cache->costs[i];
+		} else {
+			n = loan_num_payments( &(terms[i]), payments[i] );
+			p = n * payments[i];
+			if(cache != NULL) {
+				cache->payments[i] = payments[i];
+				cache->costs[i] = p;
+			}
+		}
 
 		// Fitness is proportional to total amount paid over all loans
 		f += p;
 
 		if(VERBOSE)
-			printf("\tGene: %.2f\tMonthly payment: %.2f\n", individual->genes[i], payments[i]);
+			printf("\tGene: %.2f\tMonthly payment: %.2f\n", micro_ga_gene(individual, i), payments[i]);
 
 		// Make sure the loan can be paid off at this amount
 		// Loans with montly payments too low will take infinite time to pay off
@@ -179,25 +599,471 @@ void eval_fitness(micro_ga_genome_t* individual)
 		}
 	}
 
+	// Judge the plan over all rate paths instead
+	if(ROBUST_SCENARIOS)
+	{
+		scenario_cost_t cost;
+		if(scenario_evaluate(&scenarios, payments, &cost) != 0) {
+			individual->fitness = 1e-10;
+			return;
+		}
+		f = (1.0 - ROBUST_TAIL_WEIGHT) * cost.expected + ROBUST_TAIL_WEIGHT * cost.tail;
+	}
+
 	// Optimize inverse because GA wants to achieve f = 1.0
 	f = 1.0f / f;
 	individual->fitness = f;
+
+	// Cache matches the genome again
+	individual->first_changed = NUM_LOANS;
+}
+
+/*
+ * Evaluate a whole generation over the simulated rate paths at once. Plans
+ * race each other on a growing number of shared paths, so only the plans
+ * close to the best are evaluated on all of them.
+ */
+void eval_fitness_batch(micro_ga_genome_t* individuals, unsigned int count, void* user_data)
+{
+	scenario_race_config_t race =
+	{
+		.initial_scenarios = ROBUST_RACE_INITIAL,
+		.eta               = 4,
+		.tail_weight       = ROBUST_TAIL_WEIGHT
+	};
+	float* payments;
+	double* scores;
+	unsigned int* racing;
+	unsigned int n, feasible = 0;
+	unsigned long int evaluations = 0;
+
+	payments = (float*)malloc(sizeof(float) * NUM_LOANS * count);
+	scores = (double*)malloc(sizeof(double) * count);
+	racing = (unsigned int*)malloc(sizeof(unsigned int) * count);
+	if(payments == NULL || scores == NULL || racing == NULL) {
+		for(n = 0; n < count; n++)
+			individuals[n].fitness = 1e-10;
+		free(racing);
+		free(scores);
+		free(payments);
+		return;
+	}
+
+	// Plans which can't pay off a loan at today's rates never enter the race
+	for(n = 0; n < count; n++)
+	{
+		genome_to_payments(&individuals[n], &payments[feasible * NUM_LOANS]);
+		if(payments_feasible(&payments[feasible * NUM_LOANS])) {
+			racing[feasible++] = n;
+		} else {
+			individuals[n].fitness = 1e-10;
+		}
+	}
+
+	// Fitness only orders the plans: plans dropped early are scored above
+	// every plan which outlasted them, not by their cost on fewer paths, so
+	// it isn't an estimate of cost comparable between rounds.
+	if(feasible > 0)
+	{
+		if(scenario_race(&scenarios, &race, payments, feasible, scores, &evaluations) == 0) {
+			for(n = 0; n < feasible; n++)
+				individuals[racing[n]].fitness = 1.0 / scores[n];
+		} else {
+			for(n = 0; n < feasible; n++)
+				individuals[racing[n]].fitness = 1e-10;
+		}
+		scenario_evaluations += evaluations;
+	}
+
+	free(racing);
+	free(scores);
+	free(payments);
+}
+
+/* Split the payment in whole cents */
+void optimize_cents(float fitness_thresh)
+{
+	micro_ga_genome_t* best;
+	long long int total = 0, sum = 0;
+	unsigned int n, j, months;
+	micro_ga_t ga;
+
+	micro_ga_config_t config = 
+	{
+		.population_size = POP_SIZE,
+		.genome_size     = NUM_LOANS,
+		.mutation_rate   = 0.1,
+		.crossover_rate  = 0.7,
+		.fitness_thresh  = fitness_thresh,
+		.min_replace     = MIN_REPLACE,
+		.fitness_fn      = &eval_cents_fitness,
+		.acceptance_fn   = NULL,
+		.cache_size      = sizeof(cents_cache_t),
+		.genome_type     = MICRO_GA_CENTS,
+		.init_sampling   = (LATIN_INIT ? MICRO_GA_LATIN_INIT : MICRO_GA_RANDOM_INIT),
+		.cents_total     = (unsigned int)llround(PAYMENT_NOMINAL * 100.0),
+		.dedup_size      = DEDUP_SIZE,
+		.debug           = GA_TRACE
+	};
+	assert( micro_ga_init(&ga, &config) == 0 );
+
+	n = 0;
+	do
+	{
+		micro_ga_evolve(&ga);
+	} while(++n < MAX_ITERATIONS);
+
+	// Children of the last evolution still need their fitness
+	micro_ga_evaluate(&ga);
+	micro_ga_sort(&ga);
+
+	// Best plan, every amount is exact
+	best = &ga.individuals[POP_SIZE - 1];
+	printf("Summary\n");
+	printf("-------\n");
+	for(j = 0; j < NUM_LOANS; j++) {
+		total += total_paid_cents( &(terms[j]), best->cents[j], SCHEDULE_YEARS * 12, &months );
+		sum += best->cents[j];
+		printf(" Loan %u:\tPayment: $%u.%02u\tYears: %.2f\n", j, best->cents[j] / 100,
+			   best->cents[j] % 100, months / 12.0);
+	}
+	printf("Monthly Payment: $%lld.%02lld\n", sum / 100, sum % 100);
+	printf("Total Paid:      $%lld.%02lld\n", total / 100, total % 100);
+	printf("\n");
+
+	micro_ga_destroy(&ga);
+}
+
+/* Total paid on a plan in whole cents, see eval_fitness for the cache */
+void eval_cents_fitness(micro_ga_genome_t* individual)
+{
+	cents_cache_t* cache = (cents_cache_t*)individual->cache;
+	long long int total = 0, p;
+	unsigned int i;
+
+	for(i = 0; i < NUM_LOANS; i++)
+	{
+		if(individual->first_changed > 0 && cache->payments[i] == individual->cents[i]) {
+			p = cache->costs[i];
+		} else {
+			p = total_paid_cents( &(terms[i]), individual->cents[i], SCHEDULE_YEARS * 12, NULL );
+			cache->payments[i] = individual->cents[i];
+			cache->costs[i] = p;
+		}
+
+		// Not paid off in time
+		if(p < 0) {
+			individual->fitness = 1e-10;
+			return;
+		}
+		total += p;
+	}
+
+	individual->fitness = 100.0 / total;
+	individual->first_changed = NUM_LOANS;
 }
 
-/* Compute the total number of payments given the loan and a monthly payment */
-float num_payments(loan_t* loan, double monthly_payment)
+/* Split the payment by simulated annealing */
+void optimize_anneal(void)
 {
-	float i = loan->interest_rate / 12.0 / 100.0;
-	float n  = -1 * log10(1 - i * loan->principal / monthly_payment );
-	return n /= log10(1 + i);
+	clock_t begin, end;
+	sim_anneal_t sa;
+	unsigned int j;
+	double t = 0;
+
+	init_anneal(&sa, ANNEAL_MOVES, 100.0);
+
+	// Slices only matter for keeping the best solution
+	begin = clock();
+	while(sim_anneal_run(&sa, 1 << 16) > 0)
+		;
+	end = clock();
+
+	printf("Summary\n");
+	printf("-------\n");
+	for(j = 0; j < NUM_LOANS; j++) {
+		t += total_paid( &(loans[j]), sa.best[j] );
+		printf(" Loan %u:\tPayment: $%.2f\tYears: %.2f\n", j, sa.best[j],
+			   num_payments( &(loans[j]), sa.best[j] ) / 12.0);
+	}
+	printf("Monthly Payment: $%.2f\n", PAYMENT_NOMINAL);
+	printf("Total Paid:      $%.2f\n", t);
+	printf("Moves:           %lu (%lu accepted, %.1fM per second)\n", sa.move, sa.accepted,
+		   sa.move / ((double)(end - begin) / CLOCKS_PER_SEC + 1e-9) / 1e6);
+	printf("\n");
+
+	sim_anneal_destroy(&sa);
+}
+
+/*
+ * Start annealing from each loan's interest plus a share of the rest of the
+ * payment by principal. A temperature of zero only accepts improvements.
+ */
+void init_anneal(sim_anneal_t* sa, unsigned long int moves, double temp)
+{
+	double start[NUM_LOANS], interest[NUM_LOANS];
+	double principal = 0, surplus = PAYMENT_NOMINAL;
+	unsigned int j;
+
+	for(j = 0; j < NUM_LOANS; j++) {
+		interest[j] = terms[j].interest;
+		surplus -= interest[j];
+		principal += loans[j].principal;
+	}
+	for(j = 0; j < NUM_LOANS; j++)
+		start[j] = interest[j] + surplus * loans[j].principal / principal;
+
+	sim_anneal_config_t config =
+	{
+		.size         = NUM_LOANS,
+		.lower        = NULL,
+		.initial_temp = temp,
+		.final_temp   = temp / 1e4,
+		.initial_step = PAYMENT_NOMINAL / NUM_LOANS,
+		.final_step   = 0.01,
+		.num_moves    = moves,
+		.cost_fn      = &eval_anneal_cost,
+		.user_data    = NULL,
+		.seed         = rand()
+	};
+	assert( sim_anneal_init(sa, &config, start) == 0 );
 }
 
-/* Compute the total paid given the loan and a monthly payment */
-float total_paid(loan_t* loan, double monthly_payment)
+/* Total paid on one loan, loans which are never paid off cost infinitely much */
+double eval_anneal_cost(unsigned int index, double value, void* user_data)
 {
-	float i = loan->interest_rate / 12.0 / 100.0;
-	float n = num_payments(loan, monthly_payment);
-	return n * monthly_payment;
+	double p = loan_total_paid( &(terms[index]), value );
+	return (isnan(p) ? HUGE_VAL : p);
+}
+
+/*
+ * Race the GA, simulated annealing and local search (annealing without
+ * uphill moves) on the payment split.
+ */
+void optimize_race(void)
+{
+	double payments[NUM_LOANS];
+	sim_anneal_t anneal, local;
+	race_result_t result;
+	micro_ga_t ga;
+	unsigned int e, j;
+
+	micro_ga_config_t ga_config = 
+	{
+		.population_size = POP_SIZE,
+		.genome_size     = NUM_LOANS,
+		.mutation_rate   = 0.1,
+		.crossover_rate  = 0.7,
+		.fitness_thresh  = 0,
+		.fitness_fn      = &eval_fitness,
+		.acceptance_fn   = NULL,
+		.cache_size      = sizeof(split_cache_t),
+		.dedup_size      = DEDUP_SIZE,
+		.dedup_quantum   = 0.01 / PAYMENT_NOMINAL,
+		.debug           = 0
+	};
+	assert( micro_ga_init(&ga, &ga_config) == 0 );
+
+	// Schedules long enough to fill the deadline on a small portfolio
+	init_anneal(&anneal, (unsigned long int)(RACE_DEADLINE * 2e6), 100.0);
+	init_anneal(&local, (unsigned long int)(RACE_DEADLINE * 2e6), 0.0);
+
+	race_engine_t engines[3] =
+	{
+		{ .name = "GA",        .step_fn = &race_ga_step,     .best_fn = &race_ga_best,     .engine = &ga },
+		{ .name = "Annealing", .step_fn = &race_anneal_step, .best_fn = &race_anneal_best, .engine = &anneal },
+		{ .name = "Local",     .step_fn = &race_anneal_step, .best_fn = &race_anneal_best, .engine = &local }
+	};
+	race_config_t config =
+	{
+		.solution_size = NUM_LOANS,
+		.deadline      = RACE_DEADLINE,
+		.grace         = RACE_DEADLINE / 4,
+		.dominance     = 0.001
+	};
+	assert( race_engines(engines, 3, &config, payments, &result) == 0 );
+
+	printf("Summary\n");
+	printf("-------\n");
+	for(e = 0; e < 3; e++) {
+		printf(" %-10s\tBest: $%.2f\tSteps: %lu\t%s\n", engines[e].name, engines[e].cost, engines[e].steps,
+			   (engines[e].state == RACE_DONE ? "done" :
+				engines[e].state == RACE_CANCELLED ? "cancelled" : "stopped"));
+	}
+	printf("\n");
+	for(j = 0; j < NUM_LOANS; j++) {
+		printf(" Loan %u:\tPayment: $%.2f\tYears: %.2f\n", j, payments[j],
+			   num_payments( &(loans[j]), payments[j] ) / 12.0);
+	}
+	printf("Monthly Payment: $%.2f\n", PAYMENT_NOMINAL);
+	printf("Total Paid:      $%.2f (%s, %.2f seconds)\n", result.cost, engines[result.winner].name, result.elapsed);
+	printf("\n");
+
+	micro_ga_destroy(&ga);
+	sim_anneal_destroy(&anneal);
+	sim_anneal_destroy(&local);
+}
+
+/* Split the payment between groups of loans evolving side by side */
+void optimize_coevolve(void)
+{
+	float payments[NUM_LOANS];
+	unsigned int group_size = COEVOLVE_GROUP_SIZE;
+	double total;
+	unsigned int j;
+
+	coevolve_config_t config =
+	{
+		.group_size      = group_size,
+		.population_size = POP_SIZE,
+		.generations     = MAX_ITERATIONS,
+		.epochs          = COEVOLVE_EPOCHS,
+		.mutation_rate   = 1.0 / group_size,
+		.crossover_rate  = 0.7,
+		.num_threads     = 0
+	};
+	if(coevolve_optimize(&config, loans, NUM_LOANS, PAYMENT_NOMINAL, payments, &total) != 0) {
+		printf("The payment doesn't cover every loan's interest and minimum payment\n");
+		return;
+	}
+
+	printf("Summary\n");
+	printf("-------\n");
+	for(j = 0; j < NUM_LOANS; j++) {
+		printf(" Loan %u:\tPayment: $%.2f\tYears: %.2f\n", j, payments[j],
+			   num_payments( &(loans[j]), payments[j] ) / 12.0);
+	}
+	printf("Monthly Payment: $%.2f\n", PAYMENT_NOMINAL);
+	printf("Total Paid:      $%.2f\n", total);
+	printf("\n");
+}
+
+/* One generation, the GA never finishes on its own */
+unsigned int race_ga_step(void* engine)
+{
+	micro_ga_evolve((micro_ga_t*)engine);
+	return 1;
+}
+
+double race_ga_best(void* engine, double* solution)
+{
+	micro_ga_t* ga = (micro_ga_t*)engine;
+	float payments[NUM_LOANS];
+	unsigned int i;
+	double cost = 0;
+
+	// Children of the last evolution still need their fitness
+	micro_ga_evaluate(ga);
+
+	genome_to_payments(&ga->individuals[ga->best], payments);
+	for(i = 0; i < NUM_LOANS; i++) {
+		solution[i] = payments[i];
+		cost += eval_anneal_cost(i, payments[i], NULL);
+	}
+
+	return cost;
+}
+
+unsigned int race_anneal_step(void* engine)
+{
+	return (sim_anneal_run((sim_anneal_t*)engine, 1 << 14) > 0);
+}
+
+double race_anneal_best(void* engine, double* solution)
+{
+	sim_anneal_t* sa = (sim_anneal_t*)engine;
+
+	memcpy(solution, sa->best, sizeof(double) * NUM_LOANS);
+
+	return sa->best_cost;
+}
+
+/* Search for the best payoff order */
+void optimize_order(float fitness_thresh)
+{
+	unsigned int n;
+	micro_ga_t ga;
+
+	assert( payoff_init(&payoff, loans, NUM_LOANS, PAYMENT_NOMINAL, SCHEDULE_YEARS * 12) == 0 );
+
+	// About one swap or move per child
+	micro_ga_config_t config = 
+	{
+		.population_size = POP_SIZE,
+		.genome_size     = NUM_LOANS,
+		.mutation_rate   = 1.0 / NUM_LOANS,
+		.crossover_rate  = 0.7,
+		.fitness_thresh  = fitness_thresh,
+		.min_replace     = MIN_REPLACE,
+		.fitness_fn      = &eval_order_fitness,
+		.acceptance_fn   = NULL,
+		.genome_type     = MICRO_GA_PERMUTATION,
+		.permutation_crossover = ORDER_CROSSOVER,
+		.dedup_size      = DEDUP_SIZE,
+		.debug           = GA_TRACE
+	};
+	assert( micro_ga_init(&ga, &config) == 0 );
+
+	n = 0;
+	do
+	{
+		micro_ga_evolve(&ga);
+	} while(++n < MAX_ITERATIONS);
+
+	// Children of the last evolution still need their fitness
+	micro_ga_evaluate(&ga);
+
+	// Done, print results
+	micro_ga_sort(&ga);
+	print_order_info(&ga);
+
+	micro_ga_destroy(&ga);
+	payoff_destroy(&payoff);
+}
+
+/* Evaluate the fitness of a payoff order by simulating it month by month */
+void eval_order_fitness(micro_ga_genome_t* individual)
+{
+	individual->fitness = 1.0 / payoff_evaluate(&payoff, individual->order);
+}
+
+/*
+ * Evaluate the fitness of a time-varying schedule by simulating it month by
+ * month. The individual's cache holds the simulation state at the start of
+ * every period, so only periods from the first changed gene on are simulated.
+ */
+void eval_schedule_fitness(micro_ga_genome_t* individual)
+{
+	unsigned int first_period = individual->first_changed / NUM_LOANS;
+	double total;
+
+	total = schedule_evaluate(&schedule, schedule_genes(individual), individual->cache, first_period, NULL);
+	individual->first_changed = schedule_genome_size(&schedule);
+	individual->fitness = 1.0 / total;
+}
+
+/* Genes of a schedule as floats, 16-bit genes are converted to compact_genes */
+const float* schedule_genes(micro_ga_genome_t* individual)
+{
+	unsigned long int g;
+
+	if(individual->genes != NULL)
+		return individual->genes;
+
+	for(g = 0; g < schedule_genome_size(&schedule); g++)
+		compact_genes[g] = micro_ga_gene(individual, g);
+	return compact_genes;
+}
+
+/* Check that every loan can be paid off with the given monthly payments */
+unsigned int payments_feasible(float* payments)
+{
+	unsigned int i;
+	for(i = 0; i < NUM_LOANS; i++) {
+		if(isnan( loan_num_payments(&(terms[i]), payments[i]) ))
+			return 0;
+	}
+	return 1;
 }
 
 /* 
@@ -207,7 +1073,7 @@ float total_paid(loan_t* loan, double monthly_payment)
  */
 float monthly_nominal(micro_ga_genome_t* individual)
 {
-	return (float)PAYMENT_NOMINAL + PAYMENT_DEVIATION * (individual->genes[NUM_LOANS - 1]);
+	return (float)PAYMENT_NOMINAL + PAYMENT_DEVIATION * micro_ga_gene(individual, NUM_LOANS - 1);
 }
 
 /*
@@ -236,7 +1102,7 @@ void genome_to_payments(micro_ga_genome_t* individual, float* payments)
 	unsigned int i;
 	for(i = 0; i < NUM_LOANS - 1; i++)
 	{
-		payments[i] = remaining * individual->genes[i];
+		payments[i] = remaining * micro_ga_gene(individual, i);
 		remaining -= payments[i];
 	}
 	// Last payment is the leftover amount
@@ -271,7 +1137,139 @@ void print_info(micro_ga_t* ga)
 
 		printf("Monthly Payment: $%.2f\n", monthly_nominal( &(ga->individuals[i]) ));
 		printf("Total Paid:      $%.2f\n", t);
+
+		if(ROBUST_SCENARIOS)
+		{
+			scenario_cost_t cost;
+			if(scenario_evaluate(&scenarios, payments, &cost) == 0) {
+				printf("Expected Paid:   $%.2f\n", cost.expected);
+				printf("Worst 5%% Paid:   $%.2f\n", cost.tail);
+				printf("Unpaid Paths:    %u / %u\n", cost.unpaid, ROBUST_SCENARIOS);
+			}
+		}
+		printf("\n");
+	}
+}
+
+/* Print information about time-varying schedules */
+void print_schedule_info(micro_ga_t* ga)
+{
+	float* payments;
+	double t;
+	unsigned int i, j, m, payoff;
+
+	payments = (float*)malloc(sizeof(float) * schedule.num_months * NUM_LOANS);
+	assert(payments != NULL);
+
+	printf("Summary\n");
+	printf("-------\n");
+
+	for(i = 0; i < POP_SIZE; i++)
+	{
+		t = schedule_evaluate(&schedule, schedule_genes(&ga->individuals[i]), NULL, 0, payments);
+
+		printf("Individual %u\n", i);
+		printf("--------------\n");
+
+		for(j = 0; j < NUM_LOANS; j++) {
+			payoff = 0;
+			for(m = 0; m < schedule.num_months; m++) {
+				if(payments[m * NUM_LOANS + j] > 0)
+					payoff = m + 1;
+			}
+			printf(" Loan %u:\tFirst Payment: $%.2f\tYears: %.2f\n", j, payments[j], payoff / 12.0);
+		}
+
+		printf("Total Paid:      $%.2f\n", t);
+		printf("\n");
+	}
+
+	// Best schedule's first year, month by month
+	printf("First year of the best schedule\n");
+	printf("-------------------------------\n");
+	for(m = 0; m < 12 && m < schedule.num_months; m++) {
+		printf(" Month %2u:", m + 1);
+		for(j = 0; j < NUM_LOANS; j++)
+			printf("\t$%.2f", payments[m * NUM_LOANS + j]);
 		printf("\n");
 	}
+	printf("\n");
+
+	free(payments);
 }
 
+/* Print information about payoff orders, and the usual strategies for comparison */
+void print_order_info(micro_ga_t* ga)
+{
+	unsigned short order[NUM_LOANS];
+	unsigned int i, j, k;
+
+	printf("Summary\n");
+	printf("-------\n");
+
+	for(i = 0; i < POP_SIZE; i++)
+	{
+		printf("Individual %u\n", i);
+		printf("--------------\n");
+		printf("Payoff Order:   ");
+		for(j = 0; j < NUM_LOANS; j++)
+			printf(" %u", ga->individuals[i].order[j]);
+		printf("\n");
+		printf("Total Paid:      $%.2f\n", 1.0 / ga->individuals[i].fitness);
+		printf("\n");
+	}
+
+	// Avalanche, highest rate first
+	for(j = 0; j < NUM_LOANS; j++) {
+		for(k = j; k > 0 && loans[order[k - 1]].interest_rate < loans[j].interest_rate; k--)
+			order[k] = order[k - 1];
+		order[k] = j;
+	}
+	printf("Avalanche Paid:  $%.2f\n", payoff_evaluate(&payoff, order));
+
+	// Snowball, smallest balance first
+	for(j = 0; j < NUM_LOANS; j++) {
+		for(k = j; k > 0 && loans[order[k - 1]].principal > loans[j].principal; k--)
+			order[k] = order[k - 1];
+		order[k] = j;
+	}
+	printf("Snowball Paid:   $%.2f\n", payoff_evaluate(&payoff, order));
+
+	// Ground truth for the GA
+	if(ORDER_EXHAUSTIVE && NUM_LOANS <= PAYOFF_ENUMERATE_MAX)
+	{
+		double total;
+		if(payoff_enumerate(&payoff, 0, order, &total) == 0) {
+			printf("Optimal Paid:    $%.2f\n", total);
+			printf("Optimal Order:  ");
+			for(j = 0; j < NUM_LOANS; j++)
+				printf(" %u", order[j]);
+			printf("\n");
+		}
+	}
+	else if(ORDER_EXHAUSTIVE)
+	{
+		payoff_bnb_result_t result;
+		payoff_bnb_config_t config =
+		{
+			.num_threads = 0,
+			.time_limit  = ORDER_TIME_LIMIT,
+			.initial     = ga->individuals[POP_SIZE - 1].order
+		};
+		if(payoff_branch_and_bound(&payoff, &config, order, &result) == 0) {
+			if(result.optimal) {
+				printf("Optimal Paid:    $%.2f\n", result.total);
+			} else {
+				printf("Best Paid:       $%.2f (at most $%.2f above optimal)\n",
+					   result.total, result.total - result.lower_bound);
+			}
+			printf("Best Order:     ");
+			for(j = 0; j < NUM_LOANS; j++)
+				printf(" %u", order[j]);
+			printf("\n");
+			if(VERBOSE)
+				printf("Orders Expanded: %lu\n", result.nodes);
+		}
+	}
+	printf("\n");
+}
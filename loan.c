@@ -0,0 +1,54 @@
+#include <stddef.h>
+#include <math.h>
+
+#include "loan.h"
+
+void loan_terms(const loan_t* loan, loan_terms_t* terms)
+{
+	double i = loan->interest_rate / 12.0 / 100.0;
+
+	terms->interest        = i * loan->principal;
+	terms->principal       = loan->principal;
+	terms->inv_log_growth  = (i > 0 ? 1.0 / log1p(i) : 0.0);
+	terms->rate_ppb        = llround(i * 1e9);
+	terms->principal_cents = llround(loan->principal * 100.0);
+}
+
+float num_payments(loan_t* loan, double monthly_payment)
+{
+	loan_terms_t terms;
+	loan_terms(loan, &terms);
+	return loan_num_payments(&terms, monthly_payment);
+}
+
+float total_paid(loan_t* loan, double monthly_payment)
+{
+	loan_terms_t terms;
+	loan_terms(loan, &terms);
+	return loan_total_paid(&terms, monthly_payment);
+}
+
+long long int total_paid_cents(const loan_terms_t* terms, long long int monthly_cents,
+							   unsigned int max_months, unsigned int* months)
+{
+	// Interest of up to $100M fits 64 bits
+	long long int balance = terms->principal_cents;
+	long long int total = 0, pay, interest;
+	unsigned int m;
+
+	for(m = 0; m < max_months && balance > 0; m++) {
+		// Balance never goes down
+		interest = (balance * terms->rate_ppb + 500000000LL) / 1000000000LL;
+		if(interest >= monthly_cents)
+			break;
+		balance += interest;
+		pay = (monthly_cents < balance ? monthly_cents : balance);
+		balance -= pay;
+		total += pay;
+	}
+
+	if(months != NULL)
+		*months = m;
+
+	return (balance > 0 ? -1 : total);
+}
@@ -0,0 +1,83 @@
+#ifndef LOAN_H_
+#define LOAN_H_
+
+#include <math.h>
+
+typedef struct {
+	float interest_rate;	/// Annual interest rate in percent
+	float principal;		/// Initial principal amount
+	float rate_volatility;	/// Annual std. dev. of the rate in percent points (0 = fixed rate)
+	float min_payment;		/// Required monthly payment (0 = none)
+} loan_t;
+
+/*
+ * Constants of a loan's cost as a function of the monthly payment, so that
+ * evaluating a payment only does the part which depends on it. For a fixed
+ * portfolio, LOAN_TERMS() builds them as constant expressions, e.g.
+ *   static const loan_terms_t terms[] = { LOAN_TERMS(5.00, 1500.00), ... };
+ * and loan_terms() computes them at run time for any loan.
+ */
+typedef struct {
+	double interest;			/// First month's interest, payments must be above it
+	double principal;
+	double inv_log_growth;		/// 1 / ln(1 + monthly rate), 0 for interest free loans
+	long long int rate_ppb;		/// Monthly rate in billionths, for integer amortization
+	long long int principal_cents;
+} loan_terms_t;
+
+/*
+ * ln(1 + x) as a series, a constant expression for constant x. Exact to
+ * double precision for monthly rates up to a few percent.
+ */
+#define LOAN_LN1P(x)	((x) * (1.0 - (x) * (1.0/2 - (x) * (1.0/3 - (x) * (1.0/4 - (x) * \
+						(1.0/5 - (x) * (1.0/6 - (x) * (1.0/7 - (x) * (1.0/8 - (x) * \
+						(1.0/9 - (x) * (1.0/10 - (x) / 11.0)))))))))))
+
+/* Initializer of a loan_terms_t from the annual rate in percent and the principal */
+#define LOAN_TERMS(rate, principal_)											\
+	{	.interest        = (principal_) * (rate) / 1200.0,						\
+		.principal       = (principal_),										\
+		.inv_log_growth  = ((rate) > 0 ? 1.0 / LOAN_LN1P((rate) / 1200.0) : 0.0),	\
+		.rate_ppb        = (long long int)((rate) / 1200.0 * 1e9 + 0.5),		\
+		.principal_cents = (long long int)((principal_) * 100.0 + 0.5) }
+
+/* Compute a loan's terms at run time */
+void loan_terms(const loan_t* loan, loan_terms_t* terms);
+
+/* Number of payments for a monthly payment, NaN if it doesn't cover the interest */
+static inline double loan_num_payments(const loan_terms_t* terms, double monthly_payment)
+{
+	if(terms->inv_log_growth == 0)
+		return (monthly_payment > 0 ? terms->principal / monthly_payment : NAN);
+	if(monthly_payment <= terms->interest)
+		return NAN;
+	return -log1p(-terms->interest / monthly_payment) * terms->inv_log_growth;
+}
+
+/* Total paid for a monthly payment, NaN if it doesn't cover the interest */
+static inline double loan_total_paid(const loan_terms_t* terms, double monthly_payment)
+{
+	return loan_num_payments(terms, monthly_payment) * monthly_payment;
+}
+
+/* Compute the total number of payments given the loan and a monthly payment */
+float num_payments(loan_t* loan, double monthly_payment);
+
+/* Compute the total paid given the loan and a monthly payment */
+float total_paid(loan_t* loan, double monthly_payment);
+
+/** 
+ *  Compute the total paid in cents, month by month as a lender would: each
+ *  month's interest is rounded to the cent, the last payment only pays off
+ *  what is left. Integer arithmetic only.
+ *  
+ *  @param terms
+ *  @param monthly_cents Monthly payment in cents
+ *  @param max_months Months the loan must be paid off in
+ *  @param months Output, # of payments, may be NULL
+ *  @return Total paid in cents, -1 if not paid off within max_months
+ */
+long long int total_paid_cents(const loan_terms_t* terms, long long int monthly_cents,
+							   unsigned int max_months, unsigned int* months);
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * The loan split of loan-optimize.c on micro-ga.hpp: one monthly payment is
+ * split between 3 loans so that the total paid is lowest. Built by
+ * make hpp-example, which keeps the header compiling.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <cmath>
+
+#include "micro-ga.hpp"
+
+extern "C" {
+#include "loan.h"
+}
+
+#define NUM_LOANS		3
+#define POP_SIZE		15
+#define MAX_ITERATIONS	50
+#define PAYMENT			1250.00
+
+static loan_t loans[NUM_LOANS] =
+{
+	{ 5.00, 1500.00, 0, 0 },
+	{ 3.50, 10000.00, 0, 0 },
+	{ 9.50, 5000.00, 0, 0 },
+};
+
+/*
+ * Genes are stick-breaking fractions, as in loan-optimize.c: loan i gets
+ * gene i of what the loans before it left, the last loan the rest.
+ */
+struct split_fitness
+{
+	loan_terms_t terms[NUM_LOANS];
+
+	split_fitness()
+	{
+		for(unsigned int i = 0; i < NUM_LOANS; i++)
+			loan_terms(&loans[i], &terms[i]);
+	}
+
+	static void payments(const std::array<float, NUM_LOANS>& genes, double* out)
+	{
+		double remaining = PAYMENT;
+		for(unsigned int i = 0; i < NUM_LOANS - 1; i++) {
+			out[i] = remaining * genes[i];
+			remaining -= out[i];
+		}
+		out[NUM_LOANS - 1] = remaining;
+	}
+
+	float operator()(const std::array<float, NUM_LOANS>& genes) const
+	{
+		double p[NUM_LOANS], total = 0;
+
+		payments(genes, p);
+		for(unsigned int i = 0; i < NUM_LOANS; i++)
+			total += loan_total_paid(&terms[i], p[i]);
+
+		// A payment below a loan's interest never pays it off
+		return (std::isnan(total) ? 1e-10f : (float)(1.0 / total));
+	}
+};
+
+int main()
+{
+	double minimum_total_payment = 0, p[NUM_LOANS];
+	unsigned int i, n;
+
+	srand(time(NULL));
+
+	for(i = 0; i < NUM_LOANS; i++)
+		minimum_total_payment += loans[i].principal;
+
+	micro_ga<float, NUM_LOANS, split_fitness> ga(POP_SIZE, 0.1f, 0.7f,
+		1.0 / (minimum_total_payment * 1.30), POP_SIZE / 2);
+
+	for(n = 0; n < MAX_ITERATIONS; n++)
+		ga.evolve();
+	ga.evaluate();
+
+	const micro_ga<float, NUM_LOANS, split_fitness>::genome_t& best = ga.best();
+	split_fitness::payments(best.genes, p);
+	for(i = 0; i < NUM_LOANS; i++)
+		printf(" Loan %u:\tPayment: $%.2f\n", i, p[i]);
+	printf("Total Paid:      $%.2f\n", 1.0 / best.fitness);
+
+	return 0;
+}
@@ -5,15 +5,102 @@
 #include <math.h>
 
 #include "micro-ga.h"
+#include "trace.h"
 #include "util.h"
 
+/*
+ * Crossover kernel for REAL genomes. Breeds child c[0:n) from mother m and
+ * father f, using the random numbers r which the registry entry asks for.
+ */
+typedef void (*crossover_kernel_t)(	const float* m, const float* f, float* c, const float* r,
+									unsigned long int n, float rate, float param);
+
+typedef struct
+{
+	crossover_kernel_t kernel;
+	unsigned int per_gene;			/// Random numbers per gene
+	unsigned int fixed;				/// Random numbers per child
+	float param;					/// Default crossover_param
+} crossover_op_t;
+
+// Crossover kernels
+static void blend_kernel(	const float* m, const float* f, float* c, const float* r,
+							unsigned long int n, float rate, float param);
+static void sbx_kernel(	const float* m, const float* f, float* c, const float* r,
+						unsigned long int n, float rate, float param);
+static void blx_kernel(	const float* m, const float* f, float* c, const float* r,
+						unsigned long int n, float rate, float param);
+static void arithmetic_kernel(	const float* m, const float* f, float* c, const float* r,
+								unsigned long int n, float rate, float param);
+static void one_point_kernel(	const float* m, const float* f, float* c, const float* r,
+								unsigned long int n, float rate, float param);
+static void two_point_kernel(	const float* m, const float* f, float* c, const float* r,
+								unsigned long int n, float rate, float param);
+static void uniform_kernel(	const float* m, const float* f, float* c, const float* r,
+							unsigned long int n, float rate, float param);
+
+/* Registry of crossover operators, indexed by micro_ga_config_t.crossover */
+static const crossover_op_t crossover_ops[] =
+{
+	[MICRO_GA_BLEND]      = { &blend_kernel,      2, 0, 0.0f  },
+	[MICRO_GA_SBX]        = { &sbx_kernel,        2, 0, 10.0f },
+	[MICRO_GA_BLX]        = { &blx_kernel,        1, 0, 0.5f  },
+	[MICRO_GA_ARITHMETIC] = { &arithmetic_kernel, 0, 1, 0.0f  },
+	[MICRO_GA_ONE_POINT]  = { &one_point_kernel,  0, 1, 0.0f  },
+	[MICRO_GA_TWO_POINT]  = { &two_point_kernel,  0, 2, 0.0f  },
+	[MICRO_GA_UNIFORM]    = { &uniform_kernel,    1, 0, 0.0f  }
+};
+
+/* Random number streams of an individual, see rng_stream() */
+#define RNG_INIT		0
+#define RNG_SELECT		1
+#define RNG_CROSSOVER	2
+#define RNG_MUTATE		3
+#define RNG_STRATA		4	/// Per gene, not individual
+
+/* Largest gene below 1 */
+#define GENE_MAX	0.99999994f
+
 // Local functions
 static void population_init(micro_ga_t* ga);
-static void crossover(	micro_ga_genome_t* mother, micro_ga_genome_t* father,
-						micro_ga_genome_t* child, unsigned long int genome_size,
-						float crossover_rate);
-static void mutate(micro_ga_genome_t* individual, float mutation_rate);
+static void crossover(	micro_ga_t* ga, micro_ga_genome_t* mother, micro_ga_genome_t* father,
+						micro_ga_genome_t* child);
+static void mutate(micro_ga_t* ga, micro_ga_genome_t* individual);
+static void crossover_permutation(	micro_ga_t* ga, micro_ga_genome_t* mother,
+									micro_ga_genome_t* father, micro_ga_genome_t* child);
+static void mutate_permutation(micro_ga_t* ga, micro_ga_genome_t* individual);
+static void crossover16(	micro_ga_t* ga, micro_ga_genome_t* mother, micro_ga_genome_t* father,
+						micro_ga_genome_t* child);
+static void mutate16(micro_ga_t* ga, micro_ga_genome_t* individual);
+static void crossover_cents(	micro_ga_t* ga, micro_ga_genome_t* mother, micro_ga_genome_t* father,
+							micro_ga_genome_t* child);
+static void mutate_cents(micro_ga_t* ga, micro_ga_genome_t* individual);
+static void spread_cents(micro_ga_t* ga, unsigned int* cents, unsigned long int left);
+static void trace_genes(micro_ga_t* ga, unsigned int n, micro_ga_genome_t* g);
 static int genome_compare(const void* genome1, const void *genome2);
+static void rank_individuals(micro_ga_t* ga);
+static void radix_rank(micro_ga_t* ga);
+static unsigned int select_individual(micro_ga_t* ga, double r);
+static void replacement_order(micro_ga_t* ga, unsigned int replace);
+static void fitness_keys(micro_ga_t* ga, unsigned long long int* keys);
+static int key_compare(const void* key1, const void* key2);
+static void rng_fill(micro_ga_t* ga, float* out, unsigned long int n);
+static float rng_unit(micro_ga_t* ga);
+static void rng_stream(micro_ga_t* ga, unsigned long int individual, unsigned int phase);
+static unsigned long long int rng_stream_key(micro_ga_t* ga, unsigned long int individual, unsigned int phase);
+static void init_samples(micro_ga_t* ga, unsigned int n, float* out);
+static unsigned long int latin_stratum(	unsigned long long int key, unsigned int half,
+										unsigned long int count, unsigned long int n);
+static unsigned long int mutation_gap(micro_ga_t* ga);
+static void free_storage(micro_ga_t* ga);
+static unsigned long long int genome_hash(micro_ga_t* ga, micro_ga_genome_t* g);
+static int dedup_lookup(micro_ga_t* ga, unsigned long long int key, float* fitness);
+static void dedup_insert(micro_ga_t* ga, unsigned long long int key, float fitness);
+static inline unsigned long long int rng_mix(unsigned long long int z);
+static void evaluate_all(micro_ga_t* ga);
+static void evaluate_one(micro_ga_t* ga, micro_ga_genome_t* individual);
+static void screen_children(micro_ga_t* ga, unsigned int candidates, unsigned int keep);
+static void surrogate_update(micro_ga_t* ga);
 
 int micro_ga_init(micro_ga_t* ga, micro_ga_config_t* config)
 {
@@ -24,10 +111,22 @@ int micro_ga_init(micro_ga_t* ga, micro_ga_config_t* config)
 		return -1;
 	if(	config->population_size == 0 ||
 		config->genome_size == 0     ||
-		config->fitness_fn == NULL   ||
+		(config->fitness_fn == NULL && config->batch_fitness_fn == NULL) ||
 		config->mutation_rate < 0    || 
 		config->crossover_rate < 0   || 
-		config->fitness_thresh < 0 )
+		config->fitness_thresh < 0   ||
+		config->crossover > MICRO_GA_UNIFORM ||
+		config->crossover_param < 0  ||
+		(config->crossover != MICRO_GA_BLEND && config->genome_type != MICRO_GA_REAL) ||
+		config->init_sampling > MICRO_GA_LATIN_INIT ||
+		(config->init_sampling != MICRO_GA_RANDOM_INIT && config->genome_type == MICRO_GA_PERMUTATION) ||
+		config->dedup_quantum < 0    ||
+		config->surrogate_max_error < 0 ||
+		(config->genome_type != MICRO_GA_REAL && config->surrogate_ratio > 1) ||
+		config->genome_type > MICRO_GA_CENTS ||
+		(config->genome_type == MICRO_GA_CENTS && config->cents_total == 0) ||
+		config->permutation_crossover > MICRO_GA_PMX ||
+		(config->genome_type == MICRO_GA_PERMUTATION && config->genome_size > 65536) )
 	{
 		return -2;
 	}
@@ -39,20 +138,146 @@ int micro_ga_init(micro_ga_t* ga, micro_ga_config_t* config)
 	ga->genome_size     = config->genome_size;
 	ga->population_size = config->population_size;
 	ga->mutation_rate   = config->mutation_rate;
+	ga->mutation_skip   = (config->mutation_rate > 0 && config->mutation_rate < 1 ?
+						   1.0 / log1p(-(double)config->mutation_rate) : 0);
 	ga->crossover_rate  = config->crossover_rate;
 	ga->fitness_thresh  = config->fitness_thresh;
+	ga->min_replace     = (config->min_replace > 0 ? config->min_replace : 1);
+	if(ga->min_replace > config->population_size - 1)
+		ga->min_replace = config->population_size - 1;
+	ga->crossover       = config->crossover;
+	ga->crossover_param = (config->crossover_param > 0 ? config->crossover_param :
+						   crossover_ops[config->crossover].param);
 	ga->fitness_fn      = config->fitness_fn;
 	ga->acceptance_fn   = config->acceptance_fn;
+	ga->batch_fitness_fn = config->batch_fitness_fn;
+	ga->user_data       = config->user_data;
+	ga->cache_size      = config->cache_size;
+	ga->debug           = config->debug;
+	ga->genome_type     = config->genome_type;
+	ga->permutation_crossover = config->permutation_crossover;
+	ga->init_sampling   = config->init_sampling;
+	ga->dedup_quantum   = config->dedup_quantum;
+	ga->surrogate_ratio = (config->surrogate_ratio > 1 ? config->surrogate_ratio : 1);
+	ga->surrogate_max_error = config->surrogate_max_error;
+	ga->cents_total     = config->cents_total;
 
-	// Allocate the population	
+	// Seed our own generator from rand(), so srand() still controls a run
+	ga->rng_seed = ((unsigned long long int)rand() << 32) ^ (unsigned long long int)rand();
+	ga->generation = 0;
+	rng_stream(ga, 0, RNG_INIT);
+
+	// Allocate the population, and the children which replace the unfit
+	// individuals. Children are kept separate so that individuals which will
+	// be replaced can still be used for breeding the replacements.
+	// With a surrogate, surrogate_ratio times as many children are bred.
 	ga->individuals = (micro_ga_genome_t*)calloc(ga->population_size, sizeof(micro_ga_genome_t));
-	if(ga->individuals == NULL) {
+	ga->children    = (micro_ga_genome_t*)calloc(ga->population_size * ga->surrogate_ratio, sizeof(micro_ga_genome_t));
+	ga->scratch     = (float*)calloc(ga->genome_size * 2, sizeof(float));
+	if(ga->genome_type == MICRO_GA_PERMUTATION) {
+		ga->order_pool       = (unsigned short*)calloc(ga->population_size * ga->genome_size, sizeof(unsigned short));
+		ga->child_order_pool = (unsigned short*)calloc(ga->population_size * ga->genome_size, sizeof(unsigned short));
+		ga->perm_scratch     = (unsigned int*)calloc(ga->genome_size * 2, sizeof(unsigned int));
+	} else if(ga->genome_type == MICRO_GA_REAL16) {
+		ga->gene16_pool       = (unsigned short*)calloc(ga->population_size * ga->genome_size, sizeof(unsigned short));
+		ga->child_gene16_pool = (unsigned short*)calloc(ga->population_size * ga->genome_size, sizeof(unsigned short));
+	} else if(ga->genome_type == MICRO_GA_CENTS) {
+		ga->cents_pool       = (unsigned int*)calloc(ga->population_size * ga->genome_size, sizeof(unsigned int));
+		ga->child_cents_pool = (unsigned int*)calloc(ga->population_size * ga->genome_size, sizeof(unsigned int));
+	} else {
+		ga->gene_pool  = (float*)calloc(ga->population_size * ga->genome_size, sizeof(float));
+		ga->child_pool = (float*)calloc(ga->population_size * ga->surrogate_ratio * ga->genome_size, sizeof(float));
+	}
+
+	// Storage for the index of the parents we choose for breeding. Worst case
+	// is that all members of the population are below the replacement
+	// threshold, and we must replace all individuals. Thus, size array to be
+	// same as total # of individuals
+	ga->prob    = (double*)calloc(ga->population_size, sizeof(double));
+	ga->rank    = (unsigned int*)calloc(ga->population_size, sizeof(unsigned int));
+	ga->guide   = (unsigned int*)calloc(ga->population_size, sizeof(unsigned int));
+	ga->parents = (unsigned int*)calloc(ga->population_size * 2 * ga->surrogate_ratio, sizeof(unsigned int));
+
+	// Keys and their double buffer for radix sorting
+	ga->rank_keys = (unsigned long long int*)calloc(ga->population_size * 2, sizeof(unsigned long long int));
+
+	if(ga->cache_size > 0) {
+		ga->cache_pool       = (unsigned char*)calloc(ga->population_size, ga->cache_size);
+		ga->child_cache_pool = (unsigned char*)calloc(ga->population_size * ga->surrogate_ratio, ga->cache_size);
+	}
+
+	if(ga->surrogate_ratio > 1) {
+		ga->surrogate = (surrogate_t*)malloc(sizeof(surrogate_t));
+		ga->predicted = (float*)calloc(ga->population_size * ga->surrogate_ratio, sizeof(float));
+		if(ga->surrogate != NULL && surrogate_init(ga->surrogate, ga->genome_size,
+				(config->surrogate_size ? config->surrogate_size : 4 * ga->population_size)) != 0)
+		{
+			free(ga->surrogate);
+			ga->surrogate = NULL;
+		}
+	}
+
+	// Table size is the next power of two, probed linearly
+	if(config->dedup_size > 0) {
+		ga->dedup_mask = 1;
+		while(ga->dedup_mask < config->dedup_size)
+			ga->dedup_mask <<= 1;
+		ga->dedup         = (micro_ga_dedup_t*)calloc(ga->dedup_mask, sizeof(micro_ga_dedup_t));
+		ga->pending       = (micro_ga_genome_t*)calloc(ga->population_size, sizeof(micro_ga_genome_t));
+		ga->pending_index = (unsigned int*)calloc(ga->population_size, sizeof(unsigned int));
+		ga->pending_key   = (unsigned long long int*)calloc(ga->population_size, sizeof(unsigned long long int));
+		ga->dedup_mask--;
+	}
+
+	if(	ga->individuals == NULL || ga->children == NULL   ||
+		ga->scratch == NULL     || ga->prob == NULL       || ga->parents == NULL ||
+		ga->rank == NULL        || ga->guide == NULL      || ga->rank_keys == NULL ||
+		(ga->genome_type == MICRO_GA_REAL && (ga->gene_pool == NULL || ga->child_pool == NULL)) ||
+		(ga->genome_type == MICRO_GA_PERMUTATION &&
+		 (ga->order_pool == NULL || ga->child_order_pool == NULL || ga->perm_scratch == NULL)) ||
+		(ga->genome_type == MICRO_GA_REAL16 && (ga->gene16_pool == NULL || ga->child_gene16_pool == NULL)) ||
+		(ga->genome_type == MICRO_GA_CENTS && (ga->cents_pool == NULL || ga->child_cents_pool == NULL)) ||
+		(ga->cache_size > 0 && (ga->cache_pool == NULL || ga->child_cache_pool == NULL)) ||
+		(config->dedup_size > 0 && (ga->dedup == NULL || ga->pending == NULL ||
+									ga->pending_index == NULL || ga->pending_key == NULL)) ||
+		(ga->surrogate_ratio > 1 && (ga->surrogate == NULL || ga->predicted == NULL)) )
+	{
+		free_storage(ga);
 		return -1;
 	}
+
 	for(n = 0; n < ga->population_size; n++) {
-		ga->individuals[n].genome_size = ga->genome_size;
+		ga->rank[n] = n;
 		ga->individuals[n].fitness = -1.0;
-		ga->individuals[n].genes = (float*)calloc(ga->genome_size, sizeof(float));
+		ga->individuals[n].first_changed = 0;
+
+		if(ga->genome_type == MICRO_GA_PERMUTATION)
+			ga->individuals[n].order = &ga->order_pool[n * ga->genome_size];
+		else if(ga->genome_type == MICRO_GA_REAL16)
+			ga->individuals[n].genes16 = &ga->gene16_pool[n * ga->genome_size];
+		else if(ga->genome_type == MICRO_GA_CENTS)
+			ga->individuals[n].cents = &ga->cents_pool[n * ga->genome_size];
+		else
+			ga->individuals[n].genes = &ga->gene_pool[n * ga->genome_size];
+
+		if(ga->cache_size > 0)
+			ga->individuals[n].cache = &ga->cache_pool[n * ga->cache_size];
+	}
+
+	for(n = 0; n < ga->population_size * ga->surrogate_ratio; n++) {
+		ga->children[n].fitness = -1.0;
+
+		if(ga->genome_type == MICRO_GA_PERMUTATION)
+			ga->children[n].order = &ga->child_order_pool[n * ga->genome_size];
+		else if(ga->genome_type == MICRO_GA_REAL16)
+			ga->children[n].genes16 = &ga->child_gene16_pool[n * ga->genome_size];
+		else if(ga->genome_type == MICRO_GA_CENTS)
+			ga->children[n].cents = &ga->child_cents_pool[n * ga->genome_size];
+		else
+			ga->children[n].genes = &ga->child_pool[n * ga->genome_size];
+
+		if(ga->cache_size > 0)
+			ga->children[n].cache = &ga->child_cache_pool[n * ga->cache_size];
 	}
 
 	// Initialize population with random genes
@@ -66,20 +291,13 @@ int micro_ga_init(micro_ga_t* ga, micro_ga_config_t* config)
 
 int micro_ga_destroy(micro_ga_t* ga)
 {
-	unsigned int n;
-
 	if(ga == NULL)
 		return -1;
 	if(ga->ready != 1)
 		return -1;
 
 	// Deallocate population
-	if(ga->individuals != NULL) {
-		for(n = 0; n < ga->population_size; n++) {
-			free(ga->individuals[n].genes);
-		}
-		free(ga->individuals);
-	}
+	free_storage(ga);
 
 	// No longer ready to be run
 	ga->ready = 0;
@@ -89,204 +307,313 @@ int micro_ga_destroy(micro_ga_t* ga)
 
 void micro_ga_evolve(micro_ga_t* ga)
 {
-	unsigned int n, x, replace, pcount, nchildren;
+	unsigned int n, x, replace, candidates, pcount, nchildren;
 	unsigned int* parents;
-	double tfitness;
+	unsigned int* rank;
 	double* prob;
-	double r1, r2, cumulative;
 	micro_ga_genome_t *mother, *father, *child;
 	micro_ga_genome_t* children;
+	micro_ga_genome_t swap;
 	
 	// Initialized?
 	assert(ga->ready == 1);
 
-	// Fitness function valid?
-	assert(ga->fitness_fn != NULL);
+	// Get population fitness from external function. The same pass sums up
+	// the roulette wheel (prob) and finds the fittest.
+	micro_ga_evaluate(ga);
 
-	// Get population fitness from external function
-	for(n = 0; n < ga->population_size; n++) {
-		ga->fitness_fn( &(ga->individuals[n]) );
-	}
+	prob = ga->prob;
+	parents = ga->parents;
+	children = ga->children;
+	rank = ga->rank;
 
-	// Need to allocate the storage for the index of the parent
-	// we choose for breeding. Worst case is that all members of the 
-	// population are below the replacement threshold, and we must replace
-	// all individuals. Thus, size array to be same as total # of individuals
-	prob = (double*)calloc(ga->population_size, sizeof(double));
-	parents = (unsigned int*)calloc(ga->population_size * 2, sizeof(unsigned int));
-	
-	// Allocate space for the generated children which replace the unfit
-	// individuals. This is necessary so that individuals which will be replaced
-	// can still be used for breeding the replacements.
-	children = (micro_ga_genome_t*)calloc(ga->population_size, sizeof(micro_ga_genome_t));
-	for(n = 0; n < ga->population_size; n++) {
-		children[n].genes = (float*)calloc(ga->genome_size, sizeof(float));
+	// Roulette wheel selection with ellitist reinsertion
+
+	// Guide table, slot k holds the first individual reaching k / population_size
+	// of the total fitness
+	for(n = 0, x = 0; n < ga->population_size; n++) {
+		while(x + 1 < ga->population_size && prob[x] < ga->fitness_total * n / ga->population_size)
+			x++;
+		ga->guide[n] = x;
 	}
 
-	if(prob == NULL || parents == NULL || children == NULL) {
-		fprintf(stderr, "Could not allocate memory\n");
-		//clean_up();
-		//abort();
+	// Individuals below the threshold are replaced, but at least min_replace
+	// so the search goes on. The fittest never is.
+	replace = ga->population_size - 1;
+	if(ga->fitness_thresh > 0) {
+		n = (ga->num_below > ga->min_replace ? ga->num_below : ga->min_replace);
+		replace = (n < replace ? n : replace);
 	}
+	replacement_order(ga, replace);
+	TRACE(ga->debug, TRACE_LEVEL_GENERATION, TRACE_GENERATION, ga->generation, replace, ga->best, ga->fitness_max);
 
-	// Roulette wheel selection with ellitist reinsertion
+	// Breed extra children for the model to screen, unless it is too far off
+	candidates = replace;
+	if(	ga->surrogate != NULL && ga->surrogate->fitted &&
+		(ga->surrogate_max_error <= 0 || ga->surrogate_error <= ga->surrogate_max_error) )
+	{
+		candidates = replace * ga->surrogate_ratio;
+	}
 
-	// Sort individuals by fitness
-	qsort(ga->individuals, ga->population_size, sizeof(micro_ga_genome_t), &genome_compare);
+	// Roulette wheel selection. Parents must not be identical, every child
+	// draws until they differ.
+	pcount = 0;
+	for(n = 0; n < candidates; n++, pcount += 2)
+	{
+		rng_stream(ga, n, RNG_SELECT);
+		do {
+			parents[pcount]     = select_individual(ga, rng_unit(ga));
+			parents[pcount + 1] = select_individual(ga, rng_unit(ga));
+		} while(parents[pcount] == parents[pcount + 1]);
+		TRACE(ga->debug, TRACE_LEVEL_INDIVIDUAL, TRACE_PARENTS, n, parents[pcount], parents[pcount + 1], 0);
+	}
 
-/*
-	for(n = 0; n < ga->population_size; n++) {
-		printf("%d\t%f\n", n, ga->individuals[n].fitness);
+	// Breed!
+	for(n = 0, nchildren = 0; n < candidates*2; n+=2, nchildren++)
+	{
+		mother = &( ga->individuals[ parents[n]   ] );
+		father = &( ga->individuals[ parents[n+1] ] );
+		child  = &( children[nchildren] );
+		rng_stream(ga, nchildren, RNG_CROSSOVER);
+		crossover(ga, mother, father, child);
 	}
-	puts("\n");
-*/
 
-	// Get sum of all individuals' fitnesses
-	tfitness = 0;
-	for(n = 0; n < ga->population_size; n++)
-		tfitness += ga->individuals[n].fitness;
+	// Mutate!
+	for(n = 0; n < candidates; n++) {
+		rng_stream(ga, n, RNG_MUTATE);
+		mutate(ga, &(children[n]));
 
-	// Get cumulative probability distribution
-	// Remember that the individuals are now in order 
-	// from least to greatest fitness
-	cumulative = 0;
-	for(n = 0; n < ga->population_size; n++) {
-		cumulative += ga->individuals[n].fitness / tfitness;
-		prob[n] = cumulative;
+		// A child which still shares a prefix with its mother starts from her
+		// evaluator state. Mothers are never replaced before this point.
+		if(ga->cache_size > 0 && children[n].first_changed > 0)
+			memcpy(children[n].cache, ga->individuals[ parents[2*n] ].cache, ga->cache_size);
+
+		TRACE(ga->debug, TRACE_LEVEL_INDIVIDUAL, TRACE_CHILD, n, children[n].first_changed,
+			  (unsigned int)genome_hash(ga, &children[n]), 0);
+		if(TRACE_LEVEL >= TRACE_LEVEL_GENE && ga->debug >= TRACE_LEVEL_GENE)
+			trace_genes(ga, n, &children[n]);
 	}
 
-	replace = ga->population_size - 1;
-	if(ga->debug)
-		printf("Replace: %d\n", replace);
+	// Keep the children predicted best in [0:replace)
+	if(ga->surrogate != NULL && ga->surrogate->fitted)
+		screen_children(ga, candidates, replace);
 
-	// TODO make this more elegant
-	// Roulette wheel selection
-	pcount = 0;
-	for(n = 0; n < replace; )
+	// Replace the individuals picked by replacement_order() with the newly
+	// created children. The storage of the replaced individuals is recycled
+	// for the next generation's children.
+	for(n = 0; n < replace; n++)
 	{
-		// Get mother
-		r1 = rand()/((double)RAND_MAX + 1);
-		for(x = 0; x < ga->population_size; x++) {
-			if(r1 <= prob[x]) {
-				parents[pcount] = x;
-				break;
-			}
-		}
+		x = rank[n];
+		TRACE(ga->debug, TRACE_LEVEL_INDIVIDUAL, TRACE_REPLACE, n, x, 0, 0);
+		swap = ga->individuals[x];
+		ga->individuals[x] = children[n];
+		children[n] = swap;
 
-		// Get father
-		r2 = rand()/((double)RAND_MAX + 1);	
-		for(x = 0; x < ga->population_size; x++) {
-			if(r2 <= prob[x]) {
-				parents[pcount + 1] = x;
-				break;
-			}
-		}
+		// Fitness of new individual is unknown!
+		ga->individuals[x].fitness = -1.0;
+	}
 
-		// Only increment counts if parents are not identical
-		if(parents[pcount] != parents[pcount + 1])
-		{
-			n++;
-			pcount += 2;
+	ga->generation++;
+}
+
+void micro_ga_evaluate(micro_ga_t* ga)
+{
+	evaluate_all(ga);
+
+	// Check the model's predictions and refit it with the new genomes
+	if(ga->surrogate != NULL)
+		surrogate_update(ga);
+}
+
+/* Fitness of a clone from the dedup table, or else from fitness_fn */
+static void evaluate_one(micro_ga_t* ga, micro_ga_genome_t* individual)
+{
+	unsigned long long int key = 0;
+
+	if(ga->dedup != NULL) {
+		key = genome_hash(ga, individual);
+		if(dedup_lookup(ga, key, &individual->fitness)) {
+			ga->dedup_hits++;
+			return;
 		}
 	}
 
-	if(ga->debug)
-	{		
-		printf("Parents: ");
-		for(n = 0; n < pcount; n++)
-			printf("%d ", parents[n]);
-		printf("\n");
+	ga->fitness_fn(individual);
 
-		printf("Fitness sorted\n");
-		for(n = 0; n < ga->population_size; n++)
-			printf("%d %f\n", n, ga->individuals[n].fitness);
-	}
+	if(ga->dedup != NULL)
+		dedup_insert(ga, key, individual->fitness);
+}
 
-	// Breed!
-	unsigned int m;
-	for(n = 0, nchildren = 0; n < replace*2; n+=2, nchildren++)
-	{
-		mother = &( ga->individuals[ parents[n]   ] );
-		father = &( ga->individuals[ parents[n+1] ] );
-		child  = &( children[nchildren] );
-		crossover(mother, father, child, ga->genome_size, ga->crossover_rate);
+/*
+ * Evaluate every individual whose fitness is unknown, and tally the
+ * population in the same pass: the cumulative fitness by individual (the
+ * roulette wheel), its total, the extremes, the fittest individual and the
+ * number below fitness_thresh.
+ */
+static void evaluate_all(micro_ga_t* ga)
+{
+	unsigned int n, count, best = 0, below = 0;
+	unsigned long long int key = 0;
+	micro_ga_genome_t* individual;
+	double total = 0;
+	float f, low = 0, high = 0;
 
-		if(ga->debug)
-		{
-			printf("Mother:\t%d\t", parents[n]);
-			for(m = 0; m < ga->genome_size; m++) {
-				printf("%.4f ", mother->genes[m]);
-			}
-			printf("\n");
+	// Fitness function valid?
+	assert(ga->fitness_fn != NULL || ga->batch_fitness_fn != NULL);
 
-			printf("Father:\t%d\t", parents[n+1]);
-			for(m = 0; m < ga->genome_size; m++) {
-				printf("%.4f ", father->genes[m]);
-			}
-			printf("\n");
+	if(ga->batch_fitness_fn != NULL && ga->dedup == NULL)
+		ga->batch_fitness_fn(ga->individuals, ga->population_size, ga->user_data);
 
-			printf("Child:\t\t");
-			for(m = 0; m < ga->genome_size; m++) {
-				printf("%.4f ", child->genes[m]);
+	// Only new individuals which aren't clones go to the batch function
+	if(ga->batch_fitness_fn != NULL && ga->dedup != NULL)
+	{
+		count = 0;
+		for(n = 0; n < ga->population_size; n++) {
+			individual = &(ga->individuals[n]);
+			if(individual->fitness >= 0)
+				continue;
+			key = genome_hash(ga, individual);
+			if(dedup_lookup(ga, key, &individual->fitness)) {
+				ga->dedup_hits++;
+				continue;
 			}
-			printf("\n");
+			ga->pending[count] = *individual;
+			ga->pending_index[count] = n;
+			ga->pending_key[count] = key;
+			count++;
 		}
 
+		if(count > 0)
+			ga->batch_fitness_fn(ga->pending, count, ga->user_data);
+
+		// Copies share genes and caches, only the rest has to go back
+		for(n = 0; n < count; n++) {
+			individual = &(ga->individuals[ ga->pending_index[n] ]);
+			individual->fitness = ga->pending[n].fitness;
+			individual->first_changed = ga->pending[n].first_changed;
+			dedup_insert(ga, ga->pending_key[n], individual->fitness);
+		}
 	}
 
-	// Mutate!
-	for(n = 0; n < replace; n++) {
-		mutate( &(children[n]), ga->mutation_rate);
+	// Survivors of the last generation keep their fitness
+	for(n = 0; n < ga->population_size; n++)
+	{
+		individual = &(ga->individuals[n]);
+		if(individual->fitness < 0 && ga->batch_fitness_fn == NULL)
+			evaluate_one(ga, individual);
+
+		f = individual->fitness;
+		TRACE(ga->debug, TRACE_LEVEL_INDIVIDUAL, TRACE_EVALUATE, n, 0, 0, f);
+		total += f;
+		ga->prob[n] = total;
+		if(n == 0 || f < low)
+			low = f;
+		if(n == 0 || f > high) {
+			high = f;
+			best = n;
+		}
+		below += (f < ga->fitness_thresh);
 	}
 
+	ga->fitness_total = total;
+	ga->fitness_min   = low;
+	ga->fitness_max   = high;
+	ga->best          = best;
+	ga->num_below     = below;
+}
 
-	// Replace the lowest ranking individuals in the original population
-	// with the newly created children
-	for(n = 0; n < replace; n++)
-	{
-		// Copy genome size over
-		ga->individuals[n].genome_size = children[n].genome_size;
+void micro_ga_sort(micro_ga_t* ga)
+{
+	unsigned int n, i, j;
+	micro_ga_genome_t first;
 
-		// Deep-copy over all the genes
-		memcpy( ga->individuals[n].genes,
-				children[n].genes,
-				sizeof(float) * ga->individuals[n].genome_size );
+	if(ga->population_size < MICRO_GA_RADIX_MIN) {
+		qsort(ga->individuals, ga->population_size, sizeof(micro_ga_genome_t), &genome_compare);
+		for(n = 0; n < ga->population_size; n++)
+			ga->rank[n] = n;
+		ga->best = ga->population_size - 1;
+		return;
+	}
 
-		// Fitness of new individual is unknown!
-		ga->individuals[n].fitness = -1.0;
+	// Move every individual to its rank, following each cycle of the
+	// permutation once. Ranks already in place point to themselves.
+	radix_rank(ga);
+	for(n = 0; n < ga->population_size; n++)
+	{
+		if(ga->rank[n] == n)
+			continue;
+
+		first = ga->individuals[n];
+		for(i = n; (j = ga->rank[i]) != n; i = j) {
+			ga->individuals[i] = ga->individuals[j];
+			ga->rank[i] = i;
+		}
+		ga->individuals[i] = first;
+		ga->rank[i] = i;
 	}
+	ga->best = ga->population_size - 1;
+}
 
-	// Free memory
-	for(n = 0; n < ga->population_size; n++) {
-		free(children[n].genes);
+int micro_ga_set_genes(micro_ga_t* ga, unsigned int n, const float* genes)
+{
+	unsigned long int g;
+	float v;
+
+	if(ga == NULL || genes == NULL || ga->ready != 1 || n >= ga->population_size)
+		return -1;
+
+	if(ga->genome_type == MICRO_GA_PERMUTATION || ga->genome_type == MICRO_GA_CENTS)
+		return -1;
+
+	if(ga->genome_type == MICRO_GA_REAL16) {
+		for(g = 0; g < ga->genome_size; g++) {
+			v = genes[g] * 65536.0f + 0.5f;
+			ga->individuals[n].genes16[g] = (unsigned short)COERCE(v, 0.0f, 65535.0f);
+		}
+	} else {
+		memcpy(ga->individuals[n].genes, genes, sizeof(float) * ga->genome_size);
 	}
-	free(children);
-	free(parents);
-	free(prob);
+	ga->individuals[n].fitness = -1.0;
+	ga->individuals[n].first_changed = 0;
+
+	return 0;
 }
 
-void micro_ga_sort(micro_ga_t* ga)
+int micro_ga_get_genes(micro_ga_t* ga, unsigned int n, float* genes)
 {
-	qsort(	ga->individuals, 
-			ga->population_size,
-			sizeof(micro_ga_genome_t),
-			&genome_compare );
+	unsigned long int g;
+
+	if(ga == NULL || genes == NULL || ga->ready != 1 || n >= ga->population_size)
+		return -1;
+
+	if(ga->genome_type == MICRO_GA_PERMUTATION || ga->genome_type == MICRO_GA_CENTS)
+		return -1;
+
+	for(g = 0; g < ga->genome_size; g++)
+		genes[g] = micro_ga_gene(&ga->individuals[n], g);
+
+	return 0;
 }
 
-void micro_ga_print_genome(micro_ga_genome_t* g)
+void micro_ga_print_genome(micro_ga_t* ga, micro_ga_genome_t* g)
 {
 	int n;
 
-	if(g == NULL)
+	if(ga == NULL || g == NULL)
 		return;
 
 	printf("Genome {\n");
 	printf("Fitness:\t%f\n", g->fitness);
-	printf("Genome Size:\t%lu\n", g->genome_size);
+	printf("Genome Size:\t%lu\n", ga->genome_size);
 	printf("Gene values: \n  ");
 
-	for(n = 0; n < g->genome_size; n++) {
-		printf("%f\t", g->genes[n]);
+	for(n = 0; n < ga->genome_size; n++) {
+		if(g->order != NULL)
+			printf("%u\t", g->order[n]);
+		else if(g->cents != NULL)
+			printf("%u\t", g->cents[n]);
+		else
+			printf("%f\t", micro_ga_gene(g, n));
 		if((n+1) % 3 == 0)
 			printf("\n  ");
 	}
@@ -294,73 +621,128 @@ void micro_ga_print_genome(micro_ga_genome_t* g)
 	printf("\n}\n");
 }
 
-static void crossover(	micro_ga_genome_t* mother, micro_ga_genome_t* father,
-						micro_ga_genome_t* child, unsigned long int genome_size,
-						float crossover_rate)
+static void crossover(	micro_ga_t* ga, micro_ga_genome_t* mother, micro_ga_genome_t* father,
+						micro_ga_genome_t* child)
 {
-	unsigned int n;
-	float c;
+	unsigned long int n, genome_size = ga->genome_size;
+	const crossover_op_t* op = &crossover_ops[ga->crossover];
+	const float* m = mother->genes;
+	const float* f = father->genes;
+	float* c = child->genes;
 
 	// All family members here?
 	assert(mother != NULL && father != NULL && child != NULL);
 
 	assert(genome_size > 0);
 
+	if(ga->genome_type == MICRO_GA_PERMUTATION) {
+		crossover_permutation(ga, mother, father, child);
+		return;
+	}
+	if(ga->genome_type == MICRO_GA_REAL16) {
+		crossover16(ga, mother, father, child);
+		return;
+	}
+	if(ga->genome_type == MICRO_GA_CENTS) {
+		crossover_cents(ga, mother, father, child);
+		return;
+	}
+
 	// Birds and the bees...
-	for(n = 0; n < genome_size; n++) {
-		// Randomly decide if this gene will be crossed over or not
-		c = rand()/((float)RAND_MAX + 1);
-		if(c > crossover_rate)
-		{
-			// Generate a new random number which determines how 
-			// much the genes will blend
-			c = rand()/((float)RAND_MAX + 1);
-			child->genes[n] = c*mother->genes[n] + (1.0f-c)*father->genes[n];
-		} else {
-			c = rand()/((float)RAND_MAX + 1);
-			if(c > 0.5)
-				child->genes[n] = mother->genes[n];
-			else
-				child->genes[n] = father->genes[n];
-		}
+	if(ga->crossover != MICRO_GA_BLEND && rng_unit(ga) >= ga->crossover_rate) {
+		memcpy(c, m, sizeof(float) * genome_size);
+	} else {
+		rng_fill(ga, ga->scratch, op->per_gene * genome_size + op->fixed);
+		op->kernel(m, f, c, ga->scratch, genome_size, ga->crossover_rate, ga->crossover_param);
 	}
 
-	// Fitness of child is unknown, genome size is the same
+	// Fitness of child is unknown
 	child->fitness = -1.0;
-	child->genome_size = genome_size;
+
+	// Child differs from its mother from the first unequal gene on
+	for(n = 0; n < genome_size && c[n] == m[n]; n++)
+		;
+	child->first_changed = (n < mother->first_changed ? n : mother->first_changed);
 }
 
-static void mutate(micro_ga_genome_t* individual, float mutation_rate)
+/* Mutated genes get a new random value */
+static void mutate(micro_ga_t* ga, micro_ga_genome_t* individual)
 {
-	unsigned int mut = 0;
-	unsigned int g;
-	double r;
-	
-	for(g = 0; g < individual->genome_size; g++)
-	{
-		// Mutate?
-		r = rand()/((double)RAND_MAX + 1);
-		if(r < mutation_rate) {
-			// Generate another random number for new gene value
-			r = rand()/((double)RAND_MAX + 1);
-			individual->genes[g] = r;
-		}
+	unsigned long int g, genome_size = ga->genome_size;
+	float* genes = individual->genes;
+
+	if(ga->genome_type == MICRO_GA_PERMUTATION) {
+		mutate_permutation(ga, individual);
+		return;
+	}
+	if(ga->genome_type == MICRO_GA_REAL16) {
+		mutate16(ga, individual);
+		return;
+	}
+	if(ga->genome_type == MICRO_GA_CENTS) {
+		mutate_cents(ga, individual);
+		return;
 	}
+
+	g = mutation_gap(ga);
+	if(g < individual->first_changed)
+		individual->first_changed = g;
+
+	for(; g < genome_size; g += 1 + mutation_gap(ga))
+		genes[g] = rng_unit(ga);
 }
 
 static void population_init(micro_ga_t* ga)
 {
-	unsigned int n, g, acceptable;
+	unsigned int n, streamed, acceptable;
+	unsigned long int g, j, left;
+	unsigned short t, *order, *genes16;
+	unsigned int* cents;
+	double wsum;
 
-	// Each individual
-	for(n = 0; n < ga->population_size; n++)
+	// Each individual. A rejected one is redrawn from the rest of its stream.
+	for(n = 0, streamed = ga->population_size; n < ga->population_size; n++)
 	{
-		// Each gene
-		for(g = 0; g < ga->individuals[n].genome_size; g++)
-		{
-			// Get a random number between 0 and 1
-			ga->individuals[n].genes[g] = rand()/((float)RAND_MAX + 1);
+		if(n != streamed) {
+			rng_stream(ga, n, RNG_INIT);
+			streamed = n;
 		}
+
+		if(ga->genome_type == MICRO_GA_PERMUTATION) {
+			// Random order (Fisher-Yates shuffle)
+			order = ga->individuals[n].order;
+			rng_fill(ga, ga->scratch, ga->genome_size);
+			for(g = 0; g < ga->genome_size; g++)
+				order[g] = g;
+			for(g = ga->genome_size - 1; g > 0; g--) {
+				j = (unsigned long int)(ga->scratch[g] * (g + 1));
+				t = order[g]; order[g] = order[j]; order[j] = t;
+			}
+		} else if(ga->genome_type == MICRO_GA_REAL16) {
+			genes16 = ga->individuals[n].genes16;
+			init_samples(ga, n, ga->scratch);
+			for(g = 0; g < ga->genome_size; g++)
+				genes16[g] = (unsigned short)(ga->scratch[g] * 65536.0f);
+		} else if(ga->genome_type == MICRO_GA_CENTS) {
+			// Random shares of the total, rounded down
+			cents = ga->individuals[n].cents;
+			init_samples(ga, n, ga->scratch);
+			wsum = 0;
+			for(g = 0; g < ga->genome_size; g++)
+				wsum += ga->scratch[g];
+			left = ga->cents_total;
+			for(g = 0; g < ga->genome_size; g++) {
+				cents[g] = (wsum > 0 ? (unsigned int)(ga->cents_total * (ga->scratch[g] / wsum)) : 0);
+				cents[g] = (cents[g] < left ? cents[g] : left);
+				left -= cents[g];
+			}
+			spread_cents(ga, cents, left);
+		} else {
+			// Random genes between 0 and 1
+			init_samples(ga, n, ga->individuals[n].genes);
+		}
+		ga->individuals[n].first_changed = 0;
+
 		// Is this solution acceptable to go into the population?
 		if(ga->acceptance_fn != NULL) {
 			acceptable = ga->acceptance_fn( &(ga->individuals[n]) );
@@ -373,6 +755,396 @@ static void population_init(micro_ga_t* ga)
 	}
 }
 
+/* Genes of initial individual n in [0:1), from its stream */
+static void init_samples(micro_ga_t* ga, unsigned int n, float* out)
+{
+	const unsigned long int count = ga->population_size;
+	unsigned long int g;
+	unsigned int half;
+	double x;
+
+	rng_fill(ga, out, ga->genome_size);
+	if(ga->init_sampling != MICRO_GA_LATIN_INIT)
+		return;
+
+	// Half the bits of a power of 4 holding every stratum
+	for(half = 1; (1UL << (2 * half)) < count; half++)
+		;
+
+	// Random number becomes the offset within the individual's stratum
+	for(g = 0; g < ga->genome_size; g++) {
+		x = (latin_stratum(rng_stream_key(ga, g, RNG_STRATA), half, count, n) + out[g]) / count;
+		out[g] = (x < GENE_MAX ? (float)x : GENE_MAX);
+	}
+}
+
+/*
+ * Stratum of individual n in [0:count), a random permutation per key. A
+ * 4 round Feistel network permutes [0:4^half), and numbers past count are
+ * permuted again until they fall inside (cycle walking). No table of
+ * strata is kept, so every individual's genes can be computed on their own.
+ */
+static unsigned long int latin_stratum(	unsigned long long int key, unsigned int half,
+										unsigned long int count, unsigned long int n)
+{
+	const unsigned long long int mask = (1ULL << half) - 1;
+	unsigned long long int l, r, t;
+	unsigned int round;
+
+	do {
+		l = n >> half;
+		r = n & mask;
+		for(round = 0; round < 4; round++) {
+			t = r;
+			r = l ^ (rng_mix(key + round * 0x9e3779b97f4a7c15ULL + r) & mask);
+			l = t;
+		}
+		n = (unsigned long int)((l << half) | r);
+	} while(n >= count);
+
+	return n;
+}
+
+/*
+ * Order preserving crossover of permutations. The child takes a random
+ * segment of its mother as is. With OX, the other positions are filled with
+ * the remaining genes in the order they appear in the father, starting after
+ * the segment. With PMX, they keep the father's genes, except genes already
+ * in the segment, which are replaced by following the mapping the segment
+ * defines between mother and father.
+ */
+static void crossover_permutation(	micro_ga_t* ga, micro_ga_genome_t* mother,
+									micro_ga_genome_t* father, micro_ga_genome_t* child)
+{
+	unsigned long int n = ga->genome_size, a, b, i, k;
+	const unsigned short* m = mother->order;
+	const unsigned short* f = father->order;
+	unsigned short* c = child->order;
+	unsigned int* mark = ga->perm_scratch;
+	unsigned int* pos = ga->perm_scratch + n;
+	unsigned int stamp;
+	unsigned short g;
+
+	// Marks are stamped instead of cleared for every child
+	if(++ga->perm_stamp == 0) {
+		memset(mark, 0, sizeof(unsigned int) * n);
+		ga->perm_stamp = 1;
+	}
+	stamp = ga->perm_stamp;
+
+	// Segment [a:b) comes from the mother
+	rng_fill(ga, ga->scratch, 2);
+	a = (unsigned long int)(ga->scratch[0] * n);
+	b = (unsigned long int)(ga->scratch[1] * n);
+	if(a > b) {
+		i = a; a = b; b = i;
+	}
+	b++;
+
+	for(i = a; i < b; i++) {
+		c[i] = m[i];
+		mark[m[i]] = stamp;
+	}
+
+	if(ga->permutation_crossover == MICRO_GA_PMX)
+	{
+		for(i = 0; i < n; i++)
+			pos[m[i]] = i;
+		for(i = 0; i < n; i++) {
+			if(i == a) {
+				i = b - 1;
+				continue;
+			}
+			for(g = f[i]; mark[g] == stamp; g = f[pos[g]])
+				;
+			c[i] = g;
+		}
+	}
+	else
+	{
+		k = b % n;
+		for(i = 0; i < n; i++) {
+			g = f[(b + i) % n];
+			if(mark[g] != stamp) {
+				c[k] = g;
+				k = (k + 1) % n;
+			}
+		}
+	}
+
+	child->fitness = -1.0;
+
+	// Child differs from its mother from the first unequal gene on
+	for(i = 0; i < n && c[i] == m[i]; i++)
+		;
+	child->first_changed = (i < mother->first_changed ? i : mother->first_changed);
+}
+
+/*
+ * Genes selected for crossover are blended by a random amount, the others
+ * are taken from a random parent. The kernels choose by 0/1 weights instead
+ * of branches, so the loops compile to vector code.
+ */
+static void blend_kernel(	const float* m, const float* f, float* c, const float* r,
+							unsigned long int n, float rate, float param)
+{
+	const float* select = r;
+	const float* blend = r + n;
+	unsigned long int g;
+	float pick, blended, taken, mixed;
+
+	for(g = 0; g < n; g++) {
+		pick = (blend[g] > 0.5f ? 1.0f : 0.0f);
+		blended = (select[g] > rate ? 1.0f : 0.0f);
+		taken = pick*m[g] + (1.0f-pick)*f[g];
+		mixed = blend[g]*m[g] + (1.0f-blend[g])*f[g];
+		c[g] = taken + blended*(mixed - taken);
+	}
+}
+
+/*
+ * Simulated binary crossover: the child is one of the two children a
+ * one-point crossover of the genes' binary codes would spread around the
+ * parents, with spread factor beta. Larger eta keeps children closer.
+ */
+static void sbx_kernel(	const float* m, const float* f, float* c, const float* r,
+						unsigned long int n, float rate, float param)
+{
+	const float e = 1.0f / (param + 1.0f);
+	const float* u = r;
+	const float* side = r + n;
+	unsigned long int g;
+	float low, beta, s, x;
+
+	for(g = 0; g < n; g++) {
+		low = (u[g] <= 0.5f ? 1.0f : 0.0f);
+		beta = powf(low * 2.0f*u[g] + (1.0f-low) / (2.0f*(1.0f-u[g])), e);
+		s = (side[g] > 0.5f ? 0.5f : -0.5f);
+		x = 0.5f*(m[g] + f[g]) + s*beta*(m[g] - f[g]);
+		c[g] = (x < 0.0f ? 0.0f : (x > GENE_MAX ? GENE_MAX : x));
+	}
+}
+
+/*
+ * BLX-alpha: uniform on the parents' interval widened by alpha times its
+ * length on both sides, i.e. m + t(f - m) with t in [-alpha:1+alpha).
+ */
+static void blx_kernel(	const float* m, const float* f, float* c, const float* r,
+						unsigned long int n, float rate, float param)
+{
+	unsigned long int g;
+	float t, x;
+
+	for(g = 0; g < n; g++) {
+		t = r[g] * (1.0f + 2.0f*param) - param;
+		x = m[g] + t*(f[g] - m[g]);
+		c[g] = (x < 0.0f ? 0.0f : (x > GENE_MAX ? GENE_MAX : x));
+	}
+}
+
+static void arithmetic_kernel(	const float* m, const float* f, float* c, const float* r,
+								unsigned long int n, float rate, float param)
+{
+	const float w = r[0];
+	unsigned long int g;
+
+	for(g = 0; g < n; g++)
+		c[g] = w*m[g] + (1.0f-w)*f[g];
+}
+
+/* Genes before a random cut in [1:n) from the mother, the rest from the father */
+static void one_point_kernel(	const float* m, const float* f, float* c, const float* r,
+								unsigned long int n, float rate, float param)
+{
+	const unsigned long int cut = 1 + (unsigned long int)((double)r[0] * (n - 1));
+
+	memcpy(c, m, sizeof(float) * cut);
+	memcpy(c + cut, f + cut, sizeof(float) * (n - cut));
+}
+
+/* Genes between two random cuts from the father, the rest from the mother */
+static void two_point_kernel(	const float* m, const float* f, float* c, const float* r,
+								unsigned long int n, float rate, float param)
+{
+	unsigned long int a = (unsigned long int)((double)r[0] * (n + 1));
+	unsigned long int b = (unsigned long int)((double)r[1] * (n + 1));
+	unsigned long int t;
+
+	if(a > b) {
+		t = a; a = b; b = t;
+	}
+	memcpy(c, m, sizeof(float) * a);
+	memcpy(c + a, f + a, sizeof(float) * (b - a));
+	memcpy(c + b, m + b, sizeof(float) * (n - b));
+}
+
+static void uniform_kernel(	const float* m, const float* f, float* c, const float* r,
+							unsigned long int n, float rate, float param)
+{
+	unsigned long int g;
+	float w;
+
+	for(g = 0; g < n; g++) {
+		w = (r[g] < 0.5f ? 1.0f : 0.0f);
+		c[g] = w*m[g] + (1.0f-w)*f[g];
+	}
+}
+
+/*
+ * Crossover of 16-bit genes, same as for REAL genes. The blend is done in
+ * fixed point: a 16-bit weight times a 16-bit gene fits 32 bits.
+ */
+static void crossover16(	micro_ga_t* ga, micro_ga_genome_t* mother, micro_ga_genome_t* father,
+						micro_ga_genome_t* child)
+{
+	unsigned long int n, genome_size = ga->genome_size;
+	float* select = ga->scratch;
+	float* blend = ga->scratch + genome_size;
+	float crossover_rate = ga->crossover_rate;
+	const unsigned short* m = mother->genes16;
+	const unsigned short* f = father->genes16;
+	unsigned short* c = child->genes16;
+	unsigned int w;
+
+	rng_fill(ga, ga->scratch, genome_size * 2);
+
+	for(n = 0; n < genome_size; n++) {
+		w = (unsigned int)(blend[n] * 65536.0f);
+		c[n] = (select[n] > crossover_rate) ?
+				(unsigned short)((w * m[n] + (65536U - w) * f[n]) >> 16) :
+				(blend[n] > 0.5f ? m[n] : f[n]);
+	}
+
+	child->fitness = -1.0;
+
+	// Child differs from its mother from the first unequal gene on
+	for(n = 0; n < genome_size && c[n] == m[n]; n++)
+		;
+	child->first_changed = (n < mother->first_changed ? n : mother->first_changed);
+}
+
+static void mutate16(micro_ga_t* ga, micro_ga_genome_t* individual)
+{
+	unsigned long int g, genome_size = ga->genome_size;
+	unsigned short* genes = individual->genes16;
+
+	g = mutation_gap(ga);
+	if(g < individual->first_changed)
+		individual->first_changed = g;
+
+	for(; g < genome_size; g += 1 + mutation_gap(ga))
+		genes[g] = (unsigned short)(rng_unit(ga) * 65536.0f);
+}
+
+/*
+ * Weighted average of the parents in cents. One weight for all genes keeps
+ * the sum, only rounding down loses less than a cent per gene.
+ */
+static void crossover_cents(	micro_ga_t* ga, micro_ga_genome_t* mother, micro_ga_genome_t* father,
+							micro_ga_genome_t* child)
+{
+	unsigned long int n, genome_size = ga->genome_size, left = ga->cents_total;
+	const unsigned int* m = mother->cents;
+	const unsigned int* f = father->cents;
+	unsigned int* c = child->cents;
+	unsigned long long int w;
+
+	w = (unsigned long long int)(rng_unit(ga) * 65536.0f);
+	for(n = 0; n < genome_size; n++) {
+		c[n] = (unsigned int)((w * m[n] + (65536ULL - w) * f[n]) >> 16);
+		left -= c[n];
+	}
+	spread_cents(ga, c, left);
+
+	child->fitness = -1.0;
+
+	// Child differs from its mother from the first unequal gene on
+	for(n = 0; n < genome_size && c[n] == m[n]; n++)
+		;
+	child->first_changed = (n < mother->first_changed ? n : mother->first_changed);
+}
+
+/* A mutated gene moves a random part of its cents to a random gene */
+static void mutate_cents(micro_ga_t* ga, micro_ga_genome_t* individual)
+{
+	unsigned long int g, j, n = ga->genome_size, first = individual->first_changed;
+	unsigned int* cents = individual->cents;
+	unsigned int amount;
+	float move[2];
+
+	for(g = mutation_gap(ga); g < n; g += 1 + mutation_gap(ga))
+	{
+		rng_fill(ga, move, 2);
+		j = (unsigned long int)(move[0] * n);
+		amount = (unsigned int)(move[1] * (cents[g] + 1.0));
+		amount = (amount < cents[g] ? amount : cents[g]);
+		cents[g] -= amount;
+		cents[j] += amount;
+
+		if(amount > 0 && g < first) first = g;
+		if(amount > 0 && j < first) first = j;
+	}
+	individual->first_changed = first;
+}
+
+/* Hand out left cents (fewer than the genome size) one per gene, after a random gene */
+static void spread_cents(micro_ga_t* ga, unsigned int* cents, unsigned long int left)
+{
+	unsigned long int g = (unsigned long int)(rng_unit(ga) * ga->genome_size);
+
+	for(; left > 0; left--) {
+		cents[g % ga->genome_size]++;
+		g++;
+	}
+}
+
+/* Each position is mutated by swapping it with, or moving it to, a random position */
+static void mutate_permutation(micro_ga_t* ga, micro_ga_genome_t* individual)
+{
+	unsigned long int g, j, n = ga->genome_size, first = individual->first_changed;
+	unsigned short* order = individual->order;
+	float move[2];
+	unsigned short t;
+
+	for(g = mutation_gap(ga); g < n; g += 1 + mutation_gap(ga))
+	{
+		rng_fill(ga, move, 2);
+		j = (unsigned long int)(move[0] * n);
+		if(move[1] < 0.5f) {
+			t = order[g]; order[g] = order[j]; order[j] = t;
+		} else if(j < g) {
+			t = order[g];
+			memmove(&order[j + 1], &order[j], sizeof(unsigned short) * (g - j));
+			order[j] = t;
+		} else {
+			t = order[g];
+			memmove(&order[g], &order[g + 1], sizeof(unsigned short) * (j - g));
+			order[j] = t;
+		}
+
+		if(g < first) first = g;
+		if(j < first) first = j;
+	}
+	individual->first_changed = first;
+}
+
+/* One TRACE_GENE event per gene of child n */
+static void trace_genes(micro_ga_t* ga, unsigned int n, micro_ga_genome_t* g)
+{
+	unsigned long int m;
+	double value;
+
+	for(m = 0; m < ga->genome_size; m++) {
+		if(ga->genome_type == MICRO_GA_PERMUTATION)
+			value = g->order[m];
+		else if(ga->genome_type == MICRO_GA_CENTS)
+			value = g->cents[m];
+		else
+			value = micro_ga_gene(g, m);
+		TRACE(ga->debug, TRACE_LEVEL_GENE, TRACE_GENE, n, (unsigned int)m, 0, value);
+	}
+}
+
 static int genome_compare(const void* genome1, const void *genome2) 
 {
 	float fitness1 = ((micro_ga_genome_t*)genome1)->fitness;
@@ -387,3 +1159,375 @@ static int genome_compare(const void* genome1, const void *genome2)
 	}
 }
 
+/* Fill rank[] with the individuals from least to greatest fitness */
+static void rank_individuals(micro_ga_t* ga)
+{
+	unsigned int n;
+
+	if(ga->population_size >= MICRO_GA_RADIX_MIN) {
+		radix_rank(ga);
+		return;
+	}
+
+	fitness_keys(ga, ga->rank_keys);
+	qsort(ga->rank_keys, ga->population_size, sizeof(unsigned long long int), &key_compare);
+	for(n = 0; n < ga->population_size; n++)
+		ga->rank[n] = (unsigned int)ga->rank_keys[n];
+}
+
+/*
+ * Individuals to replace go to rank[0:replace), the others after them. All
+ * but the fittest, or just the ones below fitness_thresh, are known from
+ * evaluate_all(). Only topping them up with the worst of the rest needs the
+ * population ranked.
+ */
+static void replacement_order(micro_ga_t* ga, unsigned int replace)
+{
+	unsigned int n, low = 0, high = ga->population_size;
+
+	if(replace + 1 == ga->population_size) {
+		for(n = 0; n < ga->population_size; n++) {
+			if(n != ga->best)
+				ga->rank[low++] = n;
+		}
+		ga->rank[low] = ga->best;
+	} else if(replace == ga->num_below) {
+		for(n = 0; n < ga->population_size; n++) {
+			if(ga->individuals[n].fitness < ga->fitness_thresh)
+				ga->rank[low++] = n;
+			else
+				ga->rank[--high] = n;
+		}
+	} else {
+		rank_individuals(ga);
+	}
+}
+
+/*
+ * (fitness key, index) pairs. Flipping the sign bit of a positive float, or
+ * every bit of a negative one, gives an unsigned key in the same order.
+ */
+static void fitness_keys(micro_ga_t* ga, unsigned long long int* keys)
+{
+	unsigned long int n;
+	unsigned int bits;
+
+	for(n = 0; n < ga->population_size; n++) {
+		memcpy(&bits, &ga->individuals[n].fitness, sizeof(bits));
+		bits ^= ((bits >> 31) ? 0xffffffffU : 0x80000000U);
+		keys[n] = ((unsigned long long int)bits << 32) | n;
+	}
+}
+
+static int key_compare(const void* key1, const void* key2)
+{
+	unsigned long long int a = *(const unsigned long long int*)key1;
+	unsigned long long int b = *(const unsigned long long int*)key2;
+
+	return (a > b) - (a < b);
+}
+
+/*
+ * LSD radix sort of (fitness key, index) pairs, 11 bits per pass. Passes
+ * over digits all keys share, e.g. the exponent of a converged population,
+ * are skipped. The sort is stable, so ties keep their index order.
+ */
+static void radix_rank(micro_ga_t* ga)
+{
+	unsigned long int count[1 << 11];
+	unsigned long int n, size = ga->population_size, total, c;
+	unsigned long long int* a = ga->rank_keys;
+	unsigned long long int* b = ga->rank_keys + size;
+	unsigned long long int* t;
+	unsigned int shift, d;
+
+	fitness_keys(ga, a);
+
+	for(shift = 32; shift < 64; shift += 11)
+	{
+		memset(count, 0, sizeof(count));
+		for(n = 0; n < size; n++)
+			count[(a[n] >> shift) & 0x7ff]++;
+		if(count[(a[0] >> shift) & 0x7ff] == size)
+			continue;
+
+		// Histogram to starting offsets
+		for(d = 0, total = 0; d < (1 << 11); d++) {
+			c = count[d];
+			count[d] = total;
+			total += c;
+		}
+		for(n = 0; n < size; n++)
+			b[ count[(a[n] >> shift) & 0x7ff]++ ] = a[n];
+
+		t = a; a = b; b = t;
+	}
+
+	for(n = 0; n < size; n++)
+		ga->rank[n] = (unsigned int)a[n];
+}
+
+/*
+ * Individual whose slice of the roulette wheel holds r in [0:1). The scan
+ * starts at the first individual reaching r's slot of the guide table, so it
+ * takes about one step.
+ */
+static unsigned int select_individual(micro_ga_t* ga, double r)
+{
+	unsigned int last = ga->population_size - 1, x;
+	unsigned long int k = (unsigned long int)(r * ga->population_size);
+	const double wheel = r * ga->fitness_total;
+
+	x = ga->guide[k < last ? k : last];
+	while(x < last && wheel > ga->prob[x])
+		x++;
+	return x;
+}
+
+/* splitmix64 finalizer, a strong 64-bit mixing function */
+static inline unsigned long long int rng_mix(unsigned long long int z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/*
+ * Switch to the stream of an individual in the current generation. Each
+ * breeding step of each child draws from its own stream, so children can be
+ * bred in any order, or on any number of threads, and come out the same.
+ */
+static void rng_stream(micro_ga_t* ga, unsigned long int individual, unsigned int phase)
+{
+	ga->rng_key = rng_stream_key(ga, individual, phase);
+	ga->rng_counter = 0;
+}
+
+static unsigned long long int rng_stream_key(micro_ga_t* ga, unsigned long int individual, unsigned int phase)
+{
+	unsigned long long int k;
+
+	k = rng_mix(ga->rng_seed + (ga->generation + 1ULL) * 0x9e3779b97f4a7c15ULL);
+	k = rng_mix(k + (individual + 1ULL) * 0x9e3779b97f4a7c15ULL);
+	return rng_mix(k + phase);
+}
+
+/*
+ * Fill out[0:n) with uniform numbers in [0:1). Each number is a hash of
+ * its position in the stream, so the loop has no carried dependency and
+ * compiles to vector code.
+ */
+static void rng_fill(micro_ga_t* ga, float* out, unsigned long int n)
+{
+	unsigned long int i;
+	unsigned long long int base = ga->rng_key + ga->rng_counter * 0x9e3779b97f4a7c15ULL;
+
+	for(i = 0; i < n; i++)
+		out[i] = (rng_mix(base + i * 0x9e3779b97f4a7c15ULL) >> 40) * (1.0f / 16777216.0f);
+
+	ga->rng_counter += n;
+}
+
+static float rng_unit(micro_ga_t* ga)
+{
+	float r;
+	rng_fill(ga, &r, 1);
+	return r;
+}
+
+/*
+ * Number of genes before the next mutated one. Instead of tossing a coin per
+ * gene, the gap is drawn from the geometric distribution those tosses would
+ * give, so mutation costs one draw per mutated gene instead of one per gene.
+ * Gaps past the genome are returned as the genome size.
+ */
+static unsigned long int mutation_gap(micro_ga_t* ga)
+{
+	double gap;
+
+	if(ga->mutation_rate >= 1)
+		return 0;
+	if(ga->mutation_rate <= 0)
+		return ga->genome_size;
+
+	gap = log(1.0 - rng_unit(ga)) * ga->mutation_skip;
+	return (gap < ga->genome_size ? (unsigned long int)gap : ga->genome_size);
+}
+
+static void free_storage(micro_ga_t* ga)
+{
+	free(ga->individuals);
+	free(ga->children);
+	free(ga->gene_pool);
+	free(ga->child_pool);
+	free(ga->cache_pool);
+	free(ga->child_cache_pool);
+	free(ga->gene16_pool);
+	free(ga->child_gene16_pool);
+	free(ga->cents_pool);
+	free(ga->child_cents_pool);
+	free(ga->scratch);
+	free(ga->prob);
+	free(ga->rank);
+	free(ga->guide);
+	free(ga->rank_keys);
+	free(ga->parents);
+	free(ga->order_pool);
+	free(ga->child_order_pool);
+	free(ga->perm_scratch);
+	free(ga->dedup);
+	free(ga->pending);
+	free(ga->pending_index);
+	free(ga->pending_key);
+	free(ga->predicted);
+	if(ga->surrogate != NULL)
+		surrogate_destroy(ga->surrogate);
+	free(ga->surrogate);
+
+	ga->individuals = NULL;
+	ga->children = NULL;
+	ga->gene_pool = NULL;
+	ga->child_pool = NULL;
+	ga->cache_pool = NULL;
+	ga->child_cache_pool = NULL;
+	ga->gene16_pool = NULL;
+	ga->child_gene16_pool = NULL;
+	ga->cents_pool = NULL;
+	ga->child_cents_pool = NULL;
+	ga->scratch = NULL;
+	ga->prob = NULL;
+	ga->rank = NULL;
+	ga->guide = NULL;
+	ga->rank_keys = NULL;
+	ga->parents = NULL;
+	ga->order_pool = NULL;
+	ga->child_order_pool = NULL;
+	ga->perm_scratch = NULL;
+	ga->dedup = NULL;
+	ga->pending = NULL;
+	ga->pending_index = NULL;
+	ga->pending_key = NULL;
+	ga->predicted = NULL;
+	ga->surrogate = NULL;
+}
+
+/* Move the keep children with the highest predicted fitness to the front */
+static void screen_children(micro_ga_t* ga, unsigned int candidates, unsigned int keep)
+{
+	micro_ga_genome_t swap;
+	unsigned int n, m, best;
+	float p;
+
+	for(n = 0; n < candidates; n++)
+		ga->predicted[n] = surrogate_predict(ga->surrogate, ga->children[n].genes);
+
+	// Partial selection sort, candidates is a small multiple of keep
+	for(n = 0; n < keep; n++)
+	{
+		best = n;
+		for(m = n + 1; m < candidates; m++) {
+			if(ga->predicted[m] > ga->predicted[best])
+				best = m;
+		}
+
+		swap = ga->children[n];
+		ga->children[n] = ga->children[best];
+		ga->children[best] = swap;
+		p = ga->predicted[n];
+		ga->predicted[n] = ga->predicted[best];
+		ga->predicted[best] = p;
+	}
+
+	ga->surrogate_screened += candidates - keep;
+
+	// Kept children become individuals [0:keep)
+	ga->num_predicted = keep;
+}
+
+static void surrogate_update(micro_ga_t* ga)
+{
+	unsigned int n;
+	double f, error;
+
+	for(n = 0; n < ga->num_predicted; n++)
+	{
+		f = ga->individuals[ ga->rank[n] ].fitness;
+		if(f <= 0)
+			continue;
+
+		error = fabs(ga->predicted[n] - f) / f;
+		ga->surrogate_error = (ga->surrogate_checked ? 0.9 * ga->surrogate_error + 0.1 * error : error);
+		ga->surrogate_checked++;
+	}
+	ga->num_predicted = 0;
+
+	for(n = 0; n < ga->population_size; n++)
+		surrogate_add(ga->surrogate, ga->individuals[n].genes, ga->individuals[n].fitness);
+	surrogate_fit(ga->surrogate);
+}
+
+/*
+ * Hash of a genome's (quantized) genes. A 64-bit hash stands in for the
+ * genes themselves; with a table of a few thousand entries, two different
+ * genomes sharing one is vanishingly unlikely.
+ */
+static unsigned long long int genome_hash(micro_ga_t* ga, micro_ga_genome_t* g)
+{
+	unsigned long long int h = ga->genome_size, v;
+	unsigned int bits;
+	unsigned long int i;
+
+	for(i = 0; i < ga->genome_size; i++)
+	{
+		if(ga->genome_type == MICRO_GA_PERMUTATION) {
+			v = g->order[i];
+		} else if(ga->genome_type == MICRO_GA_CENTS) {
+			v = g->cents[i];
+		} else if(ga->dedup_quantum > 0) {
+			v = (unsigned long long int)(long long int)floorf(micro_ga_gene(g, i) / ga->dedup_quantum + 0.5f);
+		} else if(ga->genome_type == MICRO_GA_REAL16) {
+			v = g->genes16[i];
+		} else {
+			memcpy(&bits, &g->genes[i], sizeof(bits));
+			v = bits;
+		}
+		h = rng_mix(h ^ (v + 0x9e3779b97f4a7c15ULL));
+	}
+
+	// 0 marks empty slots
+	return h | 1;
+}
+
+/* Look a few slots past the key's home slot */
+static int dedup_lookup(micro_ga_t* ga, unsigned long long int key, float* fitness)
+{
+	unsigned long int i, slot;
+
+	for(i = 0; i < 4; i++) {
+		slot = (key + i) & ga->dedup_mask;
+		if(ga->dedup[slot].key == key) {
+			*fitness = ga->dedup[slot].fitness;
+			return 1;
+		}
+		if(ga->dedup[slot].key == 0)
+			return 0;
+	}
+	return 0;
+}
+
+/* Take a free slot near home, or evict whatever lives at home */
+static void dedup_insert(micro_ga_t* ga, unsigned long long int key, float fitness)
+{
+	unsigned long int i, slot;
+
+	for(i = 0; i < 4; i++) {
+		slot = (key + i) & ga->dedup_mask;
+		if(ga->dedup[slot].key == 0 || ga->dedup[slot].key == key)
+			break;
+	}
+	if(i == 4)
+		slot = key & ga->dedup_mask;
+
+	ga->dedup[slot].key = key;
+	ga->dedup[slot].fitness = fitness;
+}
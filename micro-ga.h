@@ -1,22 +1,122 @@
 #ifndef MICRO_GA_
 #define MICRO_GA_
 
+#include "surrogate.h"
+
+/* Genome encodings */
+#define MICRO_GA_REAL			0	/// genes[] in [0:1)
+#define MICRO_GA_PERMUTATION	1	/// order[] holds each of [0:genome_size) once
+#define MICRO_GA_REAL16			2	/// genes16[] in [0:1) as multiples of 1/65536
+#define MICRO_GA_CENTS			3	/// cents[] add up to cents_total exactly
+
+/*
+ * Populations at least this large are ranked by radix sorting integer keys
+ * of the fitness, smaller ones by qsort of the same keys. Individuals stay
+ * where they are between generations (see micro_ga_t.rank).
+ */
+#define MICRO_GA_RADIX_MIN		4096
+
+/* Crossover operators for REAL genomes */
+#define MICRO_GA_BLEND			0	/// Per gene, blend by a random amount or take either parent's
+#define MICRO_GA_SBX			1	/// Simulated binary crossover, crossover_param = eta (0 = 10)
+#define MICRO_GA_BLX			2	/// BLX-alpha, crossover_param = alpha (0 = 0.5)
+#define MICRO_GA_ARITHMETIC		3	/// One random weighted average of the parents
+#define MICRO_GA_ONE_POINT		4
+#define MICRO_GA_TWO_POINT		5
+#define MICRO_GA_UNIFORM		6	/// Per gene, either parent's
+
+/* Sampling of the initial population */
+#define MICRO_GA_RANDOM_INIT	0	/// Independent uniform genes
+#define MICRO_GA_LATIN_INIT		1	/// Latin hypercube
+
+/* Crossover operators for permutation genomes */
+#define MICRO_GA_OX				0	/// Order crossover
+#define MICRO_GA_PMX			1	/// Partially mapped crossover
+
+/*
+ * An individual. Its genome size is the population's (micro_ga_t.genome_size),
+ * and only the gene array of the population's genome type is set.
+ */
 typedef struct
 {
-	unsigned long int genome_size;
 	float* genes;
+	unsigned short* order;			/// Permutation genomes only, genes is NULL
+	unsigned short* genes16;		/// 16-bit genomes only, genes is NULL
+	unsigned int* cents;			/// Cents genomes only, genes is NULL
 	float fitness;
+	void* cache;					/// Evaluator state, see micro_ga_config_t.cache_size
+	unsigned long int first_changed;	/// Genes from here on changed since cache was written
 } micro_ga_genome_t;
 
+/* Remembered fitness of a genome, see micro_ga_config_t.dedup_size */
+typedef struct
+{
+	unsigned long long int key;		/// Hash of the genome, 0 = empty
+	float fitness;
+} micro_ga_dedup_t;
+
 typedef struct
 {
 	unsigned int population_size;	/// Total # of individuals in population
 	unsigned long int genome_size;	/// Size of all individuals' genome string
 	float mutation_rate;			/// Rate of mutation [0:1]
 	float crossover_rate;			/// Genetic combination ratio [0:1]
-	float fitness_thresh;			/// Individuals replaced if below this [0:1]
+	/// Individuals below this are replaced by children each generation, the
+	/// fittest never is (0 = replace all but the fittest)
+	float fitness_thresh;
+	unsigned int min_replace;		/// Replaced even if above fitness_thresh (0 = 1)
+	/// Crossover of REAL genomes, MICRO_GA_BLEND to MICRO_GA_UNIFORM. With
+	/// MICRO_GA_BLEND, crossover_rate is the chance a gene is taken from
+	/// either parent instead of blended. With the others, it is the chance a
+	/// child is crossed over at all instead of copying its mother.
+	unsigned int crossover;
+	float crossover_param;			/// Parameter of the crossover, 0 = its default
+	/// Sets the fitness of an individual whose fitness is unknown (< 0).
+	/// Survivors keep theirs, so it must always give a genome the same fitness.
 	void (*fitness_fn)(micro_ga_genome_t* individual);	
 	unsigned int (*acceptance_fn)(micro_ga_genome_t* individual);
+	/// Evaluates the whole population at once, used instead of fitness_fn if set
+	void (*batch_fitness_fn)(micro_ga_genome_t* individuals, unsigned int count, void* user_data);
+	void* user_data;				/// Passed through to batch_fitness_fn
+	/// Bytes of evaluator state kept with every individual (0 = none). A child
+	/// inherits its mother's cache, and first_changed tells the evaluator from
+	/// which gene on the cache no longer describes the genome. The evaluator
+	/// sets first_changed to the genome size once the cache is up to date again.
+	unsigned long int cache_size;
+	/// MICRO_GA_REAL, MICRO_GA_PERMUTATION, MICRO_GA_REAL16 or MICRO_GA_CENTS.
+	/// 16-bit genes take half the memory of REAL ones, at a resolution of
+	/// 1/65536.
+	unsigned int genome_type;
+	/// Sum of every cents genome. Children are a weighted average of their
+	/// parents, rounded down, and the cents lost to rounding go one per gene
+	/// to the genes after a random one. A mutated gene gives a random part of
+	/// its cents to another gene. crossover_rate is not used.
+	unsigned int cents_total;
+	/// MICRO_GA_OX or MICRO_GA_PMX. Permutations are mutated by swapping two
+	/// positions or moving one position elsewhere.
+	unsigned int permutation_crossover;
+	/// MICRO_GA_RANDOM_INIT or MICRO_GA_LATIN_INIT. With a Latin hypercube,
+	/// every gene falls in each 1/population_size slice of [0:1) for exactly
+	/// one individual, so small populations start spread over the whole
+	/// range. Not for permutation genomes.
+	unsigned int init_sampling;
+	/// # of genome hashes whose fitness is remembered (0 = off). Clones of a
+	/// remembered genome, e.g. children of near-identical parents, get its
+	/// fitness instead of being evaluated again. Only for fitness functions
+	/// which always give a genome the same fitness.
+	unsigned int dedup_size;
+	/// Genes are rounded to multiples of this before hashing, so genomes
+	/// closer than this count as clones (0 = exact)
+	float dedup_quantum;
+	/// Children bred per replaced individual (0 or 1 = all are evaluated).
+	/// A model of the fitness over recently evaluated genomes screens them,
+	/// and only the most promising are evaluated. REAL genomes only.
+	unsigned int surrogate_ratio;
+	unsigned int surrogate_size;	/// # of evaluated genomes the model interpolates (0 = 4 * population)
+	/// Screening pauses while the model's mean relative error is above this (0 = never)
+	float surrogate_max_error;
+	/// Run-time trace level, TRACE_LEVEL_GENERATION to TRACE_LEVEL_GENE or 0
+	/// for none. Only levels compiled in (TRACE_LEVEL) are recorded, see trace.h.
 	unsigned int debug;
 } micro_ga_config_t;
 
@@ -25,9 +125,20 @@ typedef struct
 	// Population info
 	unsigned int generation;		/// Generation number (0, 1, 2...)
 	unsigned int population_size;
+
+	// Tally of the population, set by micro_ga_evaluate
+	double fitness_total;
+	float fitness_min;
+	float fitness_max;
+	unsigned int best;				/// Fittest individual
+	unsigned int num_below;			/// # of individuals below fitness_thresh
 	float mutation_rate;
+	double mutation_skip;			/// 1 / ln(1 - mutation_rate), scales mutation gaps
 	float crossover_rate;
 	float fitness_thresh;
+	unsigned int min_replace;
+	unsigned int crossover;
+	float crossover_param;
 
 	// Individuals
 	micro_ga_genome_t* individuals;	/// All individuals in population
@@ -36,11 +147,68 @@ typedef struct
 	// 
 	void (*fitness_fn)(micro_ga_genome_t* individual);	
 	unsigned int (*acceptance_fn)(micro_ga_genome_t* individual);
+	void (*batch_fitness_fn)(micro_ga_genome_t* individuals, unsigned int count, void* user_data);
+	void* user_data;
+	unsigned long int cache_size;
+	unsigned int genome_type;
+	unsigned int permutation_crossover;
+	unsigned int init_sampling;
+
+	// Storage. Genes (and caches) of a generation are single contiguous 
+	// blocks, children are bred into their own blocks and swapped in.
+	float* gene_pool;
+	unsigned char* cache_pool;
+	micro_ga_genome_t* children;
+	float* child_pool;
+	unsigned char* child_cache_pool;
+	unsigned short* gene16_pool;	/// 16-bit genomes
+	unsigned short* child_gene16_pool;
+	unsigned int* cents_pool;		/// Cents genomes
+	unsigned int* child_cents_pool;
+	unsigned int cents_total;
+	double* prob;					/// Cumulative fitness by individual, the roulette wheel
+	/// Individuals replaced by micro_ga_evolve's children first, worst first
+	/// when they had to be ranked. The identity after micro_ga_sort.
+	unsigned int* rank;
+	unsigned long long int* rank_keys;	/// Fitness key and index pairs, 2 * population (radix)
+	unsigned int* guide;			/// First individual of every 1 / population slice of prob
+	unsigned int* parents;			/// Mother/father index pairs
+	float* scratch;					/// Random numbers for breeding kernels
+	unsigned short* order_pool;		/// Permutation genomes
+	unsigned short* child_order_pool;
+	unsigned int* perm_scratch;		/// Positions and marks for permutation crossover
+	unsigned int perm_stamp;
+
+	// Fitness of recently evaluated genomes, open addressing
+	micro_ga_dedup_t* dedup;
+	unsigned long int dedup_mask;
+	float dedup_quantum;
+	unsigned long int dedup_hits;	/// # of evaluations skipped
+	micro_ga_genome_t* pending;		/// Individuals the batch function still has to evaluate
+	unsigned int* pending_index;
+	unsigned long long int* pending_key;
+
+	// Fitness model screening children, see micro_ga_config_t.surrogate_ratio
+	surrogate_t* surrogate;
+	unsigned int surrogate_ratio;
+	float surrogate_max_error;
+	float* predicted;				/// Predicted fitness of children
+	unsigned int num_predicted;		/// Individuals [0:num_predicted) have a prediction to check
+	double surrogate_error;			/// Moving average of the relative prediction error
+	unsigned long int surrogate_checked;	/// # of predictions checked
+	unsigned long int surrogate_screened;	/// # of children never evaluated
+
+	// Random number generator, seeded from rand() by micro_ga_init. Numbers
+	// come from streams keyed by (seed, generation, individual, phase), so
+	// they don't depend on the order individuals are bred in.
+	unsigned long long int rng_seed;
+	unsigned long long int rng_key;	/// Current stream
+	unsigned long long int rng_counter;	/// Numbers drawn from it
 
 	// Ready flag, everything is properly initialized
 	unsigned int ready;
 
-	// Debug print level
+	// Run-time trace level
 	unsigned int debug;
 
 } micro_ga_t;
@@ -63,8 +231,50 @@ int micro_ga_destroy(micro_ga_t* ga);
 
 void micro_ga_evolve(micro_ga_t* ga);
 
+/** 
+ *  Evaluate the fitness of every individual whose fitness is unknown, e.g.
+ *  after the last evolution and before sorting, and tally the population
+ *  (fitness_total, fitness_min, fitness_max, best and num_below).
+ *  
+ *  @param ga 
+ */
+void micro_ga_evaluate(micro_ga_t* ga);
+
+/** 
+ *  Sort the individuals from least to greatest fitness, e.g. before printing
+ *  them. Large populations are radix sorted and then permuted in place.
+ *  
+ *  @param ga 
+ */
 void micro_ga_sort(micro_ga_t* ga);
 
-void micro_ga_print_genome(micro_ga_genome_t* g);
+/** 
+ *  Replace the genes of an individual, e.g. to seed a population with known
+ *  solutions. Its fitness becomes unknown.
+ *  
+ *  @param ga 
+ *  @param n Index of the individual
+ *  @param genes genome_size genes to copy
+ *  @return 0 = success, -1 = failure (invalid pointer or index)
+ */
+int micro_ga_set_genes(micro_ga_t* ga, unsigned int n, const float* genes);
+
+/** 
+ *  Copy out the genes of an individual, e.g. to seed another population.
+ *  
+ *  @param ga 
+ *  @param n Index of the individual
+ *  @param genes Output, genome_size genes
+ *  @return 0 = success, -1 = failure (invalid pointer or index)
+ */
+int micro_ga_get_genes(micro_ga_t* ga, unsigned int n, float* genes);
+
+void micro_ga_print_genome(micro_ga_t* ga, micro_ga_genome_t* g);
+
+/* Gene i of a REAL or REAL16 genome */
+static inline float micro_ga_gene(const micro_ga_genome_t* g, unsigned long int i)
+{
+	return (g->genes16 != NULL ? g->genes16[i] * (1.0f / 65536.0f) : g->genes[i]);
+}
 
 #endif
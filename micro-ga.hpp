@@ -0,0 +1,289 @@
+#ifndef MICRO_GA_HPP_
+#define MICRO_GA_HPP_
+
+/*
+ * Header-only C++ micro GA for real genomes whose size is known at compile
+ * time. Its generation follows micro_ga_evolve with MICRO_GA_BLEND crossover:
+ * roulette wheel selection of distinct parents, blend/uniform crossover,
+ * mutation by redrawing genes, and the individuals below fitness_thresh (at
+ * least min_replace, never the fittest) replaced by children. Random numbers
+ * come from streams keyed by (seed, generation, individual, phase), as in
+ * micro-ga.c. It is not a port of micro-ga.c though: mutation tosses a coin
+ * per gene instead of drawing gaps, and there is no Latin hypercube sampling,
+ * clone detection, surrogate model or evaluator cache, so runs differ from
+ * micro_ga_evolve's. With N and the fitness functor fixed, the per-gene loops
+ * unroll (or vectorize for larger N) and the fitness is inlined into the
+ * evaluation loop instead of being called through a pointer.
+ *
+ * The functor is called as fitness(genes), genes being a const genes_t&,
+ * and returns a fitness > 0, higher is better. A genome must always get the
+ * same fitness, individuals are only evaluated while their fitness is
+ * unknown.
+ */
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstddef>
+#include <cstdlib>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+
+template <typename Gene, std::size_t N, typename Fitness>
+class micro_ga
+{
+	static_assert(std::is_floating_point<Gene>::value, "genes are real numbers in [0:1)");
+	static_assert(N > 0, "genome must not be empty");
+
+public:
+	typedef std::array<Gene, N> genes_t;
+
+	struct genome_t
+	{
+		genes_t genes;
+		float fitness;				/// -1 = unknown
+	};
+
+	/**
+	 *  Population of random genomes. Our generator is seeded from rand(), so
+	 *  srand() still controls a run.
+	 *
+	 *  @param population_size At least 2
+	 *  @param mutation_rate Rate of mutation [0:1]
+	 *  @param crossover_rate Genetic combination ratio [0:1]
+	 *  @param fitness_thresh Individuals below this are replaced by children
+	 *                        each generation (0 = replace all but the fittest)
+	 *  @param min_replace Replaced even if above fitness_thresh (0 = 1)
+	 *  @param fitness
+	 */
+	micro_ga(unsigned int population_size, float mutation_rate, float crossover_rate,
+			 float fitness_thresh = 0, unsigned int min_replace = 0, Fitness fitness = Fitness())
+	:	generation_(0), mutation_rate_(mutation_rate), crossover_rate_(crossover_rate),
+		fitness_thresh_(fitness_thresh),
+		min_replace_(std::min(std::max(min_replace, 1u), population_size - 1)),
+		fitness_(fitness), individuals_(population_size),
+		children_(population_size > 0 ? population_size - 1 : 0),
+		prob_(population_size), parents_(2 * children_.size()), rng_key_(0), rng_counter_(0)
+	{
+		unsigned int n;
+
+		if(population_size < 2 || mutation_rate < 0 || crossover_rate < 0 || fitness_thresh < 0)
+			throw std::invalid_argument("micro_ga: invalid configuration");
+
+		rng_seed_ = ((unsigned long long int)rand() << 32) ^ (unsigned long long int)rand();
+
+		for(n = 0; n < individuals_.size(); n++) {
+			rng_stream(n, RNG_INIT);
+			rng_fill(individuals_[n].genes.data(), N);
+			individuals_[n].fitness = -1.0f;
+		}
+	}
+
+	/* Evaluate, then breed the next generation */
+	void evolve()
+	{
+		unsigned int n, mother, father, pcount, below = 0;
+		unsigned int replace = (unsigned int)children_.size();
+		double tfitness = 0, cumulative = 0;
+
+		evaluate();
+
+		// Roulette wheel selection with ellitist reinsertion
+		sort();
+		for(const genome_t& g : individuals_) {
+			tfitness += g.fitness;
+			below += (g.fitness < fitness_thresh_);
+		}
+		for(n = 0; n < individuals_.size(); n++) {
+			cumulative += individuals_[n].fitness / tfitness;
+			prob_[n] = cumulative;
+		}
+
+		// Individuals below the threshold are replaced, but at least
+		// min_replace so the search goes on. The fittest never is.
+		if(fitness_thresh_ > 0)
+			replace = std::min(std::max(below, min_replace_), replace);
+
+		// Parents must not be identical, every child draws until they differ
+		for(n = 0, pcount = 0; n < replace; n++, pcount += 2) {
+			rng_stream(n, RNG_SELECT);
+			do {
+				mother = select(rng_unit());
+				father = select(rng_unit());
+			} while(mother == father);
+			parents_[pcount]     = mother;
+			parents_[pcount + 1] = father;
+		}
+
+		for(n = 0; n < replace; n++) {
+			rng_stream(n, RNG_CROSSOVER);
+			crossover(individuals_[ parents_[2*n] ], individuals_[ parents_[2*n + 1] ], children_[n]);
+			rng_stream(n, RNG_MUTATE);
+			mutate(children_[n]);
+		}
+
+		// Children replace the least fit, whose storage they take over
+		for(n = 0; n < replace; n++)
+			std::swap(individuals_[n], children_[n]);
+
+		generation_++;
+	}
+
+	/* Evaluate every individual whose fitness is unknown */
+	void evaluate()
+	{
+		for(genome_t& g : individuals_) {
+			if(g.fitness < 0)
+				g.fitness = fitness_(g.genes);
+		}
+	}
+
+	/* Sort from least to greatest fitness */
+	void sort()
+	{
+		std::sort(individuals_.begin(), individuals_.end(),
+				  [](const genome_t& a, const genome_t& b) { return a.fitness < b.fitness; });
+	}
+
+	/* Replace the genes of an individual, its fitness becomes unknown */
+	void set_genes(unsigned int n, const genes_t& genes)
+	{
+		individuals_.at(n).genes = genes;
+		individuals_[n].fitness = -1.0f;
+	}
+
+	/* Fittest individual, evaluate() first */
+	const genome_t& best() const
+	{
+		return *std::max_element(individuals_.begin(), individuals_.end(),
+				[](const genome_t& a, const genome_t& b) { return a.fitness < b.fitness; });
+	}
+
+	const genome_t& operator[](unsigned int n) const { return individuals_[n]; }
+	unsigned int population_size() const { return (unsigned int)individuals_.size(); }
+	unsigned int generation() const { return generation_; }
+
+private:
+	unsigned int generation_;
+	float mutation_rate_;
+	float crossover_rate_;
+	float fitness_thresh_;
+	unsigned int min_replace_;
+	Fitness fitness_;
+
+	std::vector<genome_t> individuals_;
+	std::vector<genome_t> children_;	/// At most all but the fittest are replaced
+	std::vector<double> prob_;			/// Cumulative selection probabilities
+	std::vector<unsigned int> parents_;	/// Mother/father index pairs
+
+	/* Random number streams of an individual, as in micro-ga.c */
+	enum { RNG_INIT, RNG_SELECT, RNG_CROSSOVER, RNG_MUTATE };
+
+	unsigned long long int rng_seed_;
+	unsigned long long int rng_key_;	/// Current stream
+	unsigned long long int rng_counter_;
+
+	/* Individual whose slice of the roulette wheel holds r */
+	unsigned int select(float r) const
+	{
+		std::vector<double>::const_iterator it = std::lower_bound(prob_.begin(), prob_.end(), (double)r);
+		return (it == prob_.end() ? (unsigned int)prob_.size() - 1 : (unsigned int)(it - prob_.begin()));
+	}
+
+	/*
+	 * Genes selected for crossover are blended by a random amount, the others
+	 * are taken from a random parent, as in micro-ga.c. Decisions compare the
+	 * raw 24-bit random numbers and become 0/1 factors: compilers don't turn
+	 * float comparisons into vector selects while floating point exceptions
+	 * are honoured, integer ones they do. A weight of 0 or 1 takes a parent's
+	 * gene as is.
+	 */
+	void crossover(const genome_t& mother, const genome_t& father, genome_t& child)
+	{
+		const unsigned int rate = (unsigned int)(crossover_rate_ * 16777216.0);
+		std::array<unsigned int, 2 * N> r;
+		std::size_t n;
+
+		rng_bits(r.data(), 2 * N);
+		for(n = 0; n < N; n++) {
+			const Gene blend = r[N + n] * (Gene)(1.0 / 16777216.0);
+			const int blended = (r[n] > rate), pick = (r[N + n] > 0x800000U);
+			const Gene w = pick + blended*(blend - pick);
+			child.genes[n] = w*mother.genes[n] + (1-w)*father.genes[n];
+		}
+		child.fitness = -1.0f;
+	}
+
+	/* Mutated genes get a new random value */
+	void mutate(genome_t& individual)
+	{
+		const unsigned int rate = (unsigned int)std::ceil(mutation_rate_ * 16777216.0);
+		std::array<unsigned int, 2 * N> r;
+		std::size_t g;
+
+		rng_bits(r.data(), 2 * N);
+		for(g = 0; g < N; g++) {
+			const Gene hit = (Gene)(r[g] < rate);
+			individual.genes[g] = hit*(r[N + g] * (Gene)(1.0 / 16777216.0)) + (1-hit)*individual.genes[g];
+		}
+	}
+
+	/* splitmix64 finalizer, as in micro-ga.c */
+	static unsigned long long int rng_mix(unsigned long long int z)
+	{
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	/*
+	 * Switch to the stream of an individual in the current generation, keyed
+	 * by (seed, generation, individual, phase) like rng_stream in micro-ga.c,
+	 * so each child's numbers don't depend on the order children are bred in.
+	 */
+	void rng_stream(unsigned long int individual, unsigned int phase)
+	{
+		unsigned long long int k;
+
+		k = rng_mix(rng_seed_ + (generation_ + 1ULL) * 0x9e3779b97f4a7c15ULL);
+		k = rng_mix(k + (individual + 1ULL) * 0x9e3779b97f4a7c15ULL);
+		rng_key_ = rng_mix(k + phase);
+		rng_counter_ = 0;
+	}
+
+	/* Uniform 24-bit numbers, out[i] / 2^24 is rng_fill's number at that position in micro-ga.c */
+	void rng_bits(unsigned int* out, std::size_t n)
+	{
+		const unsigned long long int base = rng_key_ + rng_counter_ * 0x9e3779b97f4a7c15ULL;
+		std::size_t i;
+
+		for(i = 0; i < n; i++)
+			out[i] = (unsigned int)(rng_mix(base + i * 0x9e3779b97f4a7c15ULL) >> 40);
+
+		rng_counter_ += n;
+	}
+
+	/* Uniform numbers in [0:1) */
+	template <typename T>
+	void rng_fill(T* out, std::size_t n)
+	{
+		unsigned int bits;
+		std::size_t i;
+
+		for(i = 0; i < n; i++) {
+			rng_bits(&bits, 1);
+			out[i] = (T)(bits * (1.0 / 16777216.0));
+		}
+	}
+
+	float rng_unit()
+	{
+		float r;
+		rng_fill(&r, 1);
+		return r;
+	}
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+typedef struct
+{
+	parallel_fn_t fn;
+	void* ctx;
+	unsigned long int begin;
+	unsigned long int end;
+} parallel_task_t;
+
+// Local functions
+static void run_ranges(parallel_pool_t* pool);
+static void* pool_worker(void* arg);
+
+static void* parallel_worker(void* arg)
+{
+	parallel_task_t* task = (parallel_task_t*)arg;
+	task->fn(task->ctx, task->begin, task->end);
+	return NULL;
+}
+
+unsigned int parallel_num_cpus(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n < 1 ? 1 : (unsigned int)n);
+}
+
+void parallel_for(unsigned int num_threads, unsigned long int count,
+				  parallel_fn_t fn, void* ctx)
+{
+	unsigned int t, started;
+	unsigned long int chunk;
+	parallel_task_t* tasks;
+	pthread_t* threads;
+
+	if(count == 0)
+		return;
+	if(num_threads == 0)
+		num_threads = parallel_num_cpus();
+	if(num_threads > count)
+		num_threads = count;
+
+	// Nothing to split
+	if(num_threads <= 1) {
+		fn(ctx, 0, count);
+		return;
+	}
+
+	tasks = (parallel_task_t*)calloc(num_threads, sizeof(parallel_task_t));
+	threads = (pthread_t*)calloc(num_threads, sizeof(pthread_t));
+	if(tasks == NULL || threads == NULL) {
+		free(tasks);
+		free(threads);
+		fn(ctx, 0, count);
+		return;
+	}
+
+	chunk = (count + num_threads - 1) / num_threads;
+	for(t = 0; t < num_threads; t++) {
+		tasks[t].fn    = fn;
+		tasks[t].ctx   = ctx;
+		tasks[t].begin = t * chunk < count ? t * chunk : count;
+		tasks[t].end   = (t + 1) * chunk < count ? (t + 1) * chunk : count;
+	}
+
+	// Spawn helpers, falling back to the calling thread if creation fails
+	started = 0;
+	for(t = 0; t + 1 < num_threads; t++) {
+		if(pthread_create(&threads[t], NULL, &parallel_worker, &tasks[t]) != 0)
+			break;
+		started++;
+	}
+	for(t = started; t < num_threads; t++)
+		parallel_worker(&tasks[t]);
+
+	for(t = 0; t < started; t++)
+		pthread_join(threads[t], NULL);
+
+	free(threads);
+	free(tasks);
+}
+
+int parallel_pool_init(parallel_pool_t* pool, unsigned int num_threads)
+{
+	unsigned int t;
+
+	if(pool == NULL)
+		return -1;
+
+	memset(pool, 0, sizeof(parallel_pool_t));
+	if(num_threads == 0)
+		num_threads = parallel_num_cpus();
+
+	pool->threads = (pthread_t*)calloc(num_threads, sizeof(pthread_t));
+	if(pool->threads == NULL)
+		return -1;
+
+	pthread_mutex_init(&pool->submit, NULL);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	// The calling thread is the last one, fewer workers if creation fails
+	pool->num_threads = 1;
+	for(t = 0; t + 1 < num_threads; t++) {
+		if(pthread_create(&pool->threads[t], NULL, &pool_worker, pool) != 0)
+			break;
+		pool->num_threads++;
+	}
+
+	return 0;
+}
+
+void parallel_pool_destroy(parallel_pool_t* pool)
+{
+	unsigned int t;
+
+	if(pool == NULL || pool->threads == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(t = 0; t + 1 < pool->num_threads; t++)
+		pthread_join(pool->threads[t], NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->lock);
+	pthread_mutex_destroy(&pool->submit);
+	free(pool->threads);
+	pool->threads = NULL;
+}
+
+void parallel_pool_for(parallel_pool_t* pool, unsigned long int count,
+					   parallel_fn_t fn, void* ctx)
+{
+	unsigned long int ranges;
+
+	if(count == 0)
+		return;
+
+	ranges = (pool->num_threads < count ? pool->num_threads : count);
+
+	// Nothing to split, or the pool is busy
+	if(ranges <= 1 || pthread_mutex_trylock(&pool->submit) != 0) {
+		fn(ctx, 0, count);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->fn      = fn;
+	pool->ctx     = ctx;
+	pool->count   = count;
+	pool->chunk   = (count + ranges - 1) / ranges;
+	pool->ranges  = (count + pool->chunk - 1) / pool->chunk;
+	pool->next    = 0;
+	pool->pending = pool->ranges;
+	pool->job++;
+	pthread_cond_broadcast(&pool->work);
+
+	run_ranges(pool);
+	while(pool->pending > 0)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+
+	pthread_mutex_unlock(&pool->submit);
+}
+
+/* Work on the ranges of the current job until none are left, pool->lock held */
+static void run_ranges(parallel_pool_t* pool)
+{
+	unsigned long int begin, end;
+	parallel_fn_t fn = pool->fn;
+	void* ctx = pool->ctx;
+
+	while(pool->next < pool->ranges)
+	{
+		begin = pool->next++ * pool->chunk;
+		end = (begin + pool->chunk < pool->count ? begin + pool->chunk : pool->count);
+
+		pthread_mutex_unlock(&pool->lock);
+		fn(ctx, begin, end);
+		pthread_mutex_lock(&pool->lock);
+
+		if(--pool->pending == 0)
+			pthread_cond_signal(&pool->done);
+	}
+}
+
+static void* pool_worker(void* arg)
+{
+	parallel_pool_t* pool = (parallel_pool_t*)arg;
+	unsigned long int seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	while(1)
+	{
+		while(!pool->stop && pool->job == seen)
+			pthread_cond_wait(&pool->work, &pool->lock);
+		if(pool->stop)
+			break;
+
+		seen = pool->job;
+		run_ranges(pool);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
@@ -0,0 +1,77 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <pthread.h>
+
+/* Work function, processes items [begin:end) */
+typedef void (*parallel_fn_t)(void* ctx, unsigned long int begin, unsigned long int end);
+
+/** 
+ *  Split [0:count) into contiguous ranges and process them on up to 
+ *  num_threads threads. The calling thread works on the last range.
+ *  
+ *  @param num_threads Maximum # of threads, 0 = one per online CPU
+ *  @param count Total # of items
+ *  @param fn Work function called once per range
+ *  @param ctx Passed through to fn
+ */
+void parallel_for(unsigned int num_threads, unsigned long int count,
+				  parallel_fn_t fn, void* ctx);
+
+/* Number of online CPUs, at least 1 */
+unsigned int parallel_num_cpus(void);
+
+/*
+ * Threads kept for repeated parallel_pool_for() calls, so that each call
+ * only wakes them instead of creating and joining threads. Workers sleep
+ * between jobs.
+ */
+typedef struct
+{
+	unsigned int num_threads;		/// Workers + the calling thread
+	pthread_t* threads;
+	pthread_mutex_t submit;			/// Held by the caller whose job runs
+	pthread_mutex_t lock;			/// Guards everything below
+	pthread_cond_t work;			/// A job was posted, or the pool stops
+	pthread_cond_t done;			/// The last range of the job finished
+
+	// Current job
+	parallel_fn_t fn;
+	void* ctx;
+	unsigned long int count;
+	unsigned long int chunk;		/// Items per range
+	unsigned int next;				/// Next range to hand out
+	unsigned int ranges;
+	unsigned int pending;			/// Ranges not finished yet
+	unsigned long int job;			/// # of jobs posted
+	unsigned int stop;
+} parallel_pool_t;
+
+/** 
+ *  Start the worker threads of a pool.
+ *  
+ *  @param pool Pool to initialize
+ *  @param num_threads # of threads working on a job including the calling
+ *                     thread, 0 = one per online CPU. Fewer if threads can't
+ *                     be created.
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ */
+int parallel_pool_init(parallel_pool_t* pool, unsigned int num_threads);
+
+/* Stop and join the worker threads of a pool */
+void parallel_pool_destroy(parallel_pool_t* pool);
+
+/** 
+ *  parallel_for() on the threads of a pool. The calling thread works on
+ *  ranges too. If another caller's job is running on the pool, e.g. from
+ *  an enclosing parallel_pool_for(), fn runs on the calling thread alone.
+ *  
+ *  @param pool
+ *  @param count Total # of items
+ *  @param fn Work function called once per range
+ *  @param ctx Passed through to fn
+ */
+void parallel_pool_for(parallel_pool_t* pool, unsigned long int count,
+					   parallel_fn_t fn, void* ctx);
+
+#endif
@@ -0,0 +1,624 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "payoff-search.h"
+#include "parallel.h"
+
+/* Slack for balances the simulation rounds down to zero, per loan */
+#define BNB_ROUNDING		0.005
+
+/* Partial orders expanded between checks of the time limit */
+#define BNB_CLOCK_NODES		256
+
+typedef struct
+{
+	payoff_t* payoff;
+	unsigned int prefix;			/// # of targets fixed per chunk
+	double* totals;					/// Best total of each chunk
+	unsigned short* orders;			/// Best order of each chunk
+	unsigned int failed;
+} enumerate_ctx_t;
+
+/* Partial order, the state after its targets and a bound on any completion */
+typedef struct
+{
+	double bound;					/// No completion pays less than this
+	unsigned int depth;				/// # of targets fixed
+	payoff_state_t state;
+	unsigned short* order;			/// Targets so far, depth
+} bnb_node_t;
+
+/* Partial orders of one thread. The owner works on the newest, thieves take the oldest. */
+typedef struct
+{
+	pthread_mutex_t lock;
+	bnb_node_t** nodes;
+	unsigned long int head;			/// Oldest node
+	unsigned long int tail;			/// One past the newest node
+	unsigned long int capacity;
+} bnb_queue_t;
+
+typedef struct
+{
+	payoff_t* payoff;
+	unsigned int num_threads;
+	bnb_queue_t* queues;
+	unsigned int* by_rate;			/// Loans, highest rate first
+	double max_payment;				/// Most any order can pay in a month
+
+	pthread_mutex_t best_lock;
+	double best_total;				/// Incumbent, read without the lock
+	unsigned short* best_order;
+	double open_bound;				/// Lowest bound of partial orders left when stopped
+
+	unsigned long int pending;		/// Partial orders queued or being expanded
+	unsigned long int nodes;
+	unsigned int stop;
+	unsigned int failed;
+
+	struct timespec start;
+	double time_limit;
+} bnb_t;
+
+typedef struct
+{
+	bnb_t* bnb;
+	unsigned int id;
+} bnb_worker_t;
+
+// Local functions
+static void enumerate_chunks(void* ctx, unsigned long int begin, unsigned long int end);
+static int order_less(const unsigned short* a, const unsigned short* b, unsigned int n);
+static void* bnb_worker(void* arg);
+static int bnb_expand(bnb_t* bnb, unsigned int id, bnb_node_t* node, double* scratch);
+static double bnb_bound(bnb_t* bnb, const payoff_state_t* state, double* scratch);
+static void bnb_offer(bnb_t* bnb, const unsigned short* order, double total);
+static bnb_node_t* bnb_node_new(payoff_t* payoff);
+static int bnb_push(bnb_queue_t* queue, bnb_node_t* node);
+static bnb_node_t* bnb_pop(bnb_queue_t* queue);
+static bnb_node_t* bnb_steal(bnb_queue_t* queue);
+static double bnb_elapsed(const struct timespec* start);
+
+int payoff_enumerate(payoff_t* payoff, unsigned int num_threads,
+					 unsigned short* best_order, double* best_total)
+{
+	enumerate_ctx_t ctx;
+	unsigned int n = 0, c, chunks, best;
+
+	if(payoff == NULL || best_order == NULL || best_total == NULL)
+		return -1;
+	if(payoff->num_loans > PAYOFF_ENUMERATE_MAX)
+		return -2;
+	assert(payoff->ready == 1);
+
+	n = payoff->num_loans;
+
+	// One chunk per choice of the first two targets
+	ctx.prefix = (n >= 3 ? 2 : 0);
+	chunks = (n >= 3 ? n * (n - 1) : 1);
+
+	ctx.payoff = payoff;
+	ctx.failed = 0;
+	ctx.totals = (double*)malloc(sizeof(double) * chunks);
+	ctx.orders = (unsigned short*)malloc(sizeof(unsigned short) * chunks * n);
+	if(ctx.totals == NULL || ctx.orders == NULL) {
+		free(ctx.totals);
+		free(ctx.orders);
+		return -1;
+	}
+
+	parallel_for(num_threads, chunks, &enumerate_chunks, &ctx);
+
+	// Same answer however chunks were split between threads
+	best = 0;
+	for(c = 1; c < chunks; c++) {
+		if(	ctx.totals[c] < ctx.totals[best] ||
+			(ctx.totals[c] == ctx.totals[best] && order_less(&ctx.orders[c * n], &ctx.orders[best * n], n)) )
+		{
+			best = c;
+		}
+	}
+	memcpy(best_order, &ctx.orders[best * n], sizeof(unsigned short) * n);
+	*best_total = ctx.totals[best];
+
+	free(ctx.totals);
+	free(ctx.orders);
+
+	return (ctx.failed ? -1 : 0);
+}
+
+int payoff_branch_and_bound(payoff_t* payoff, payoff_bnb_config_t* config,
+							unsigned short* best_order, payoff_bnb_result_t* result)
+{
+	bnb_t bnb;
+	bnb_worker_t* workers;
+	pthread_t* threads;
+	bnb_node_t* node;
+	unsigned short* order;
+	double mins, total, bound;
+	unsigned int n, l, m, loan, t, started;
+
+	if(payoff == NULL || config == NULL || best_order == NULL || result == NULL)
+		return -1;
+	assert(payoff->ready == 1);
+
+	n = payoff->num_loans;
+
+	memset(&bnb, 0, sizeof(bnb_t));
+	pthread_mutex_init(&bnb.best_lock, NULL);
+	bnb.payoff = payoff;
+	bnb.num_threads = (config->num_threads ? config->num_threads : parallel_num_cpus());
+	bnb.time_limit = config->time_limit;
+
+	bnb.queues     = (bnb_queue_t*)calloc(bnb.num_threads, sizeof(bnb_queue_t));
+	bnb.by_rate    = (unsigned int*)malloc(sizeof(unsigned int) * n);
+	bnb.best_order = (unsigned short*)malloc(sizeof(unsigned short) * n);
+	order          = (unsigned short*)malloc(sizeof(unsigned short) * n);
+	workers        = (bnb_worker_t*)malloc(sizeof(bnb_worker_t) * bnb.num_threads);
+	threads        = (pthread_t*)malloc(sizeof(pthread_t) * bnb.num_threads);
+	node           = bnb_node_new(payoff);
+	if(	bnb.queues == NULL || bnb.by_rate == NULL || bnb.best_order == NULL ||
+		order == NULL || workers == NULL || threads == NULL || node == NULL )
+	{
+		free(bnb.queues);
+		free(bnb.by_rate);
+		free(bnb.best_order);
+		free(order);
+		free(workers);
+		free(threads);
+		free(node);
+		pthread_mutex_destroy(&bnb.best_lock);
+		return -1;
+	}
+
+	for(t = 0; t < bnb.num_threads; t++)
+		pthread_mutex_init(&bnb.queues[t].lock, NULL);
+
+	// Highest rate first, which is also the order children are tried in
+	for(l = 0; l < n; l++) {
+		loan = l;
+		for(m = l; m > 0 && payoff->growth[bnb.by_rate[m - 1]] < payoff->growth[loan]; m--)
+			bnb.by_rate[m] = bnb.by_rate[m - 1];
+		bnb.by_rate[m] = loan;
+	}
+
+	// Minimum payments alone can exceed the budget
+	mins = 0;
+	for(l = 0; l < n; l++)
+		mins += payoff->loans[l].min_payment;
+	bnb.max_payment = (mins > payoff->budget ? mins : payoff->budget);
+
+	// Avalanche and the caller's order give the first incumbent
+	for(l = 0; l < n; l++)
+		order[l] = bnb.by_rate[l];
+	bnb.best_total = 1e300;
+	bnb_offer(&bnb, order, payoff_evaluate(payoff, order));
+	if(config->initial != NULL)
+		bnb_offer(&bnb, config->initial, payoff_evaluate(payoff, config->initial));
+
+	clock_gettime(CLOCK_MONOTONIC, &bnb.start);
+	bnb.open_bound = 1e300;
+
+	// Root is the empty order
+	payoff_start(payoff, &node->state);
+	node->depth = 0;
+	node->bound = 0;
+	bnb.pending = 1;
+	if(bnb_push(&bnb.queues[0], node) != 0) {
+		free(node);
+		bnb.pending = 0;
+		bnb.failed = 1;
+	}
+
+	started = 0;
+	for(t = 0; t + 1 < bnb.num_threads; t++) {
+		workers[t].bnb = &bnb;
+		workers[t].id = t;
+		if(pthread_create(&threads[t], NULL, &bnb_worker, &workers[t]) != 0)
+			break;
+		started++;
+	}
+	workers[bnb.num_threads - 1].bnb = &bnb;
+	workers[bnb.num_threads - 1].id = bnb.num_threads - 1;
+	bnb_worker(&workers[bnb.num_threads - 1]);
+	for(t = 0; t < started; t++)
+		pthread_join(threads[t], NULL);
+
+	// Whatever is still queued bounds the optimum from below
+	bound = bnb.open_bound;
+	for(t = 0; t < bnb.num_threads; t++) {
+		while((node = bnb_pop(&bnb.queues[t])) != NULL) {
+			if(node->bound < bound)
+				bound = node->bound;
+			free(node);
+		}
+		free(bnb.queues[t].nodes);
+		pthread_mutex_destroy(&bnb.queues[t].lock);
+	}
+	pthread_mutex_destroy(&bnb.best_lock);
+
+	total = bnb.best_total;
+	memcpy(best_order, bnb.best_order, sizeof(unsigned short) * n);
+	result->total = total;
+	result->lower_bound = (bound < total ? bound : total);
+	result->nodes = bnb.nodes;
+	result->optimal = (result->lower_bound >= total);
+
+	free(bnb.queues);
+	free(bnb.by_rate);
+	free(bnb.best_order);
+	free(order);
+	free(workers);
+	free(threads);
+
+	return (bnb.failed ? -1 : 0);
+}
+
+/*
+ * Enumerate the orders of chunks [begin:end). The loans after the fixed
+ * prefix are permuted in a[] by Heap's algorithm, and the payoff order reads
+ * a[] back to front. A Heap's step only swaps a[0:i], so the targets before
+ * depth r - 1 - i are unchanged and their states are taken from the stack.
+ */
+static void enumerate_chunks(void* ctx, unsigned long int begin, unsigned long int end)
+{
+	enumerate_ctx_t* e = (enumerate_ctx_t*)ctx;
+	payoff_t* payoff = e->payoff;
+	unsigned int n = payoff->num_loans, r = n - e->prefix;
+	unsigned int first, second, i, d, k;
+	unsigned long int chunk;
+	unsigned short a[PAYOFF_ENUMERATE_MAX], order[PAYOFF_ENUMERATE_MAX];
+	unsigned short* best;
+	unsigned int c[PAYOFF_ENUMERATE_MAX];
+	payoff_state_t stack[PAYOFF_ENUMERATE_MAX + 1];
+	double* balances;
+	double total;
+	unsigned short t;
+
+	// stack[d] is the state after d targets past the prefix
+	balances = (double*)malloc(sizeof(double) * n * (r + 1));
+	if(balances == NULL) {
+		__sync_fetch_and_add(&e->failed, 1);
+		for(chunk = begin; chunk < end; chunk++)
+			e->totals[chunk] = 1e300;
+		return;
+	}
+	for(d = 0; d <= r; d++)
+		stack[d].balance = &balances[d * n];
+
+	for(chunk = begin; chunk < end; chunk++)
+	{
+		best = &e->orders[chunk * n];
+		e->totals[chunk] = 1e300;
+
+		// Fixed targets of this chunk
+		payoff_start(payoff, &stack[0]);
+		k = 0;
+		if(e->prefix == 2) {
+			first = chunk / (n - 1);
+			second = chunk % (n - 1);
+			second += (second >= first);
+			order[0] = first;
+			order[1] = second;
+			payoff_advance(payoff, &stack[0], first);
+			payoff_advance(payoff, &stack[0], second);
+		}
+		for(i = 0; i < n; i++) {
+			if(e->prefix == 0 || (i != order[0] && i != order[1]))
+				a[k++] = i;
+		}
+
+		// Heap's algorithm, re-simulating from depth r - 1 - i
+		memset(c, 0, sizeof(c));
+		i = r;
+		while(1)
+		{
+			for(d = (i >= r ? 0 : r - 1 - i); d < r; d++) {
+				payoff_copy(payoff, &stack[d + 1], &stack[d]);
+				payoff_advance(payoff, &stack[d + 1], a[r - 1 - d]);
+				order[e->prefix + d] = a[r - 1 - d];
+			}
+
+			total = payoff_total(payoff, &stack[r]);
+			if(total < e->totals[chunk] || (total == e->totals[chunk] && order_less(order, best, n))) {
+				e->totals[chunk] = total;
+				memcpy(best, order, sizeof(unsigned short) * n);
+			}
+
+			// Next permutation
+			for(i = 1; i < r && c[i] >= i; i++)
+				c[i] = 0;
+			if(i >= r)
+				break;
+			if(i % 2 == 0) {
+				t = a[0]; a[0] = a[i]; a[i] = t;
+			} else {
+				t = a[c[i]]; a[c[i]] = a[i]; a[i] = t;
+			}
+			c[i]++;
+		}
+	}
+
+	free(balances);
+}
+
+static int order_less(const unsigned short* a, const unsigned short* b, unsigned int n)
+{
+	unsigned int i;
+	for(i = 0; i < n; i++) {
+		if(a[i] != b[i])
+			return a[i] < b[i];
+	}
+	return 0;
+}
+
+static void* bnb_worker(void* arg)
+{
+	bnb_worker_t* w = (bnb_worker_t*)arg;
+	bnb_t* bnb = w->bnb;
+	bnb_node_t* node;
+	double* scratch;
+	unsigned long int expanded = 0;
+	unsigned int t;
+
+	scratch = (double*)malloc(sizeof(double) * bnb->payoff->num_loans);
+	if(scratch == NULL) {
+		__sync_fetch_and_add(&bnb->failed, 1);
+		return NULL;
+	}
+
+	while(!__atomic_load_n(&bnb->stop, __ATOMIC_RELAXED))
+	{
+		// Own work first, then the oldest work of the others
+		node = bnb_pop(&bnb->queues[w->id]);
+		for(t = 1; node == NULL && t < bnb->num_threads; t++)
+			node = bnb_steal(&bnb->queues[(w->id + t) % bnb->num_threads]);
+
+		if(node == NULL) {
+			if(__atomic_load_n(&bnb->pending, __ATOMIC_ACQUIRE) == 0)
+				break;
+			sched_yield();
+			continue;
+		}
+
+		if(	bnb->time_limit > 0 && ++expanded % BNB_CLOCK_NODES == 0 &&
+			bnb_elapsed(&bnb->start) > bnb->time_limit )
+		{
+			__atomic_store_n(&bnb->stop, 1, __ATOMIC_RELAXED);
+			pthread_mutex_lock(&bnb->best_lock);
+			if(node->bound < bnb->open_bound)
+				bnb->open_bound = node->bound;
+			pthread_mutex_unlock(&bnb->best_lock);
+		} else if(bnb_expand(bnb, w->id, node, scratch) != 0) {
+			__sync_fetch_and_add(&bnb->failed, 1);
+			__atomic_store_n(&bnb->stop, 1, __ATOMIC_RELAXED);
+		}
+
+		free(node);
+		__atomic_sub_fetch(&bnb->pending, 1, __ATOMIC_RELEASE);
+	}
+
+	free(scratch);
+
+	return NULL;
+}
+
+/*
+ * Queue every child of a partial order whose bound can still beat the
+ * incumbent. Children are pushed lowest rate first so the highest rate one
+ * is expanded next, which makes the first dive the avalanche order.
+ */
+static int bnb_expand(bnb_t* bnb, unsigned int id, bnb_node_t* node, double* scratch)
+{
+	payoff_t* payoff = bnb->payoff;
+	unsigned int n = payoff->num_loans;
+	unsigned int j, k, l, loan, used;
+	bnb_node_t* child;
+	double best, total;
+
+	__sync_fetch_and_add(&bnb->nodes, 1);
+
+	__atomic_load(&bnb->best_total, &best, __ATOMIC_RELAXED);
+	if(node->bound >= best)
+		return 0;
+
+	for(k = n; k > 0; k--)
+	{
+		loan = bnb->by_rate[k - 1];
+		for(l = 0, used = 0; l < node->depth && !used; l++)
+			used = (node->order[l] == loan);
+		if(used)
+			continue;
+
+		child = bnb_node_new(payoff);
+		if(child == NULL)
+			return -1;
+
+		payoff_copy(payoff, &child->state, &node->state);
+		memcpy(child->order, node->order, sizeof(unsigned short) * node->depth);
+		child->depth = node->depth;
+		child->order[child->depth++] = loan;
+		payoff_advance(payoff, &child->state, loan);
+
+		// Paid off loans are no-op targets, their place in the order doesn't matter
+		for(l = 0; l < n && child->depth < n; l++) {
+			loan = bnb->by_rate[l];
+			if(child->state.balance[loan] > 0)
+				continue;
+			for(j = 0, used = 0; j < child->depth && !used; j++)
+				used = (child->order[j] == loan);
+			if(!used)
+				child->order[child->depth++] = loan;
+		}
+
+		if(child->depth == n) {
+			total = payoff_total(payoff, &child->state);
+			bnb_offer(bnb, child->order, total);
+			free(child);
+			continue;
+		}
+
+		child->bound = bnb_bound(bnb, &child->state, scratch);
+		__atomic_load(&bnb->best_total, &best, __ATOMIC_RELAXED);
+		if(child->bound >= best) {
+			free(child);
+			continue;
+		}
+
+		__atomic_add_fetch(&bnb->pending, 1, __ATOMIC_RELAXED);
+		if(bnb_push(&bnb->queues[id], child) != 0) {
+			__atomic_sub_fetch(&bnb->pending, 1, __ATOMIC_RELAXED);
+			free(child);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Lower bound on the total paid by any completion of a partial order.
+ * Dropping minimum payments and letting every month pay up to the most any
+ * order can, paying the highest rate open loans first is the cheapest
+ * policy, and every real completion is one of the policies allowed.
+ */
+static double bnb_bound(bnb_t* bnb, const payoff_state_t* state, double* scratch)
+{
+	payoff_t* payoff = bnb->payoff;
+	unsigned int n = payoff->num_loans;
+	unsigned int l, first, month;
+	double total = state->total, cash, pay;
+
+	memcpy(scratch, state->balance, sizeof(double) * n);
+
+	// Loans are paid off in rate order, skip the ones already done
+	first = 0;
+	cash = state->carry;
+	month = state->month;
+	while(1)
+	{
+		for(l = first; l < n && cash > 0; l++) {
+			pay = (cash < scratch[bnb->by_rate[l]] ? cash : scratch[bnb->by_rate[l]]);
+			scratch[bnb->by_rate[l]] -= pay;
+			cash -= pay;
+			total += pay;
+		}
+		while(first < n && scratch[bnb->by_rate[first]] <= 0)
+			first++;
+
+		if(first == n || month >= payoff->horizon)
+			break;
+		month++;
+
+		for(l = first; l < n; l++)
+			scratch[bnb->by_rate[l]] *= payoff->growth[bnb->by_rate[l]];
+		cash = bnb->max_payment;
+	}
+
+	// Anything left at the end is paid off in one go
+	for(l = first; l < n; l++)
+		total += scratch[bnb->by_rate[l]];
+
+	return total - BNB_ROUNDING * n;
+}
+
+/* Replace the incumbent if this order is cheaper, ties go to the smaller order */
+static void bnb_offer(bnb_t* bnb, const unsigned short* order, double total)
+{
+	unsigned int n = bnb->payoff->num_loans;
+
+	pthread_mutex_lock(&bnb->best_lock);
+	if(total < bnb->best_total || (total == bnb->best_total && order_less(order, bnb->best_order, n))) {
+		__atomic_store(&bnb->best_total, &total, __ATOMIC_RELAXED);
+		memcpy(bnb->best_order, order, sizeof(unsigned short) * n);
+	}
+	pthread_mutex_unlock(&bnb->best_lock);
+}
+
+/* One block holding the node, its balances and its order */
+static bnb_node_t* bnb_node_new(payoff_t* payoff)
+{
+	unsigned int n = payoff->num_loans;
+	bnb_node_t* node;
+
+	node = (bnb_node_t*)malloc(sizeof(bnb_node_t) + (sizeof(double) + sizeof(unsigned short)) * n);
+	if(node == NULL)
+		return NULL;
+
+	node->state.balance = (double*)(node + 1);
+	node->order = (unsigned short*)(node->state.balance + n);
+
+	return node;
+}
+
+static int bnb_push(bnb_queue_t* queue, bnb_node_t* node)
+{
+	bnb_node_t** nodes;
+	unsigned long int capacity;
+
+	pthread_mutex_lock(&queue->lock);
+
+	// Move to the front before growing
+	if(queue->tail == queue->capacity && queue->head > 0) {
+		memmove(queue->nodes, &queue->nodes[queue->head], sizeof(bnb_node_t*) * (queue->tail - queue->head));
+		queue->tail -= queue->head;
+		queue->head = 0;
+	}
+	if(queue->tail == queue->capacity) {
+		capacity = (queue->capacity ? queue->capacity * 2 : 64);
+		nodes = (bnb_node_t**)realloc(queue->nodes, sizeof(bnb_node_t*) * capacity);
+		if(nodes == NULL) {
+			pthread_mutex_unlock(&queue->lock);
+			return -1;
+		}
+		queue->nodes = nodes;
+		queue->capacity = capacity;
+	}
+	queue->nodes[queue->tail++] = node;
+
+	pthread_mutex_unlock(&queue->lock);
+
+	return 0;
+}
+
+static bnb_node_t* bnb_pop(bnb_queue_t* queue)
+{
+	bnb_node_t* node = NULL;
+
+	pthread_mutex_lock(&queue->lock);
+	if(queue->tail > queue->head)
+		node = queue->nodes[--queue->tail];
+	if(queue->tail == queue->head)
+		queue->head = queue->tail = 0;
+	pthread_mutex_unlock(&queue->lock);
+
+	return node;
+}
+
+static bnb_node_t* bnb_steal(bnb_queue_t* queue)
+{
+	bnb_node_t* node = NULL;
+
+	pthread_mutex_lock(&queue->lock);
+	if(queue->tail > queue->head)
+		node = queue->nodes[queue->head++];
+	if(queue->tail == queue->head)
+		queue->head = queue->tail = 0;
+	pthread_mutex_unlock(&queue->lock);
+
+	return node;
+}
+
+static double bnb_elapsed(const struct timespec* start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
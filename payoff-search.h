@@ -0,0 +1,62 @@
+#ifndef PAYOFF_SEARCH_H_
+#define PAYOFF_SEARCH_H_
+
+#include "payoff.h"
+
+/* Largest portfolio payoff_enumerate() accepts (12! orders) */
+#define PAYOFF_ENUMERATE_MAX	12
+
+/** 
+ *  Find the cheapest payoff order by simulating all of them. Orders are
+ *  split into chunks by their first two targets, which are spread over
+ *  threads. Within a chunk, orders are generated with Heap's algorithm
+ *  so consecutive orders share a prefix whose simulation is reused; on
+ *  average fewer than three targets are re-simulated per order.
+ *  
+ *  @param payoff
+ *  @param num_threads 0 = one per CPU
+ *  @param best_order Output, num_loans loan indices. Ties go to the
+ *                    lexicographically smallest order.
+ *  @param best_total Output total paid by best_order
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ *          -2 = more than PAYOFF_ENUMERATE_MAX loans
+ */
+int payoff_enumerate(payoff_t* payoff, unsigned int num_threads,
+					 unsigned short* best_order, double* best_total);
+
+typedef struct
+{
+	unsigned int num_threads;		/// 0 = one per CPU
+	double time_limit;				/// Seconds, 0 = no limit
+	const unsigned short* initial;	/// Known good order (e.g. from the GA), may be NULL
+} payoff_bnb_config_t;
+
+typedef struct
+{
+	double total;					/// Total paid by the best order found
+	double lower_bound;				/// No order pays less than this
+	unsigned long int nodes;		/// # of partial orders expanded
+	unsigned int optimal;			/// Search completed, the best order is optimal
+} payoff_bnb_result_t;
+
+/** 
+ *  Find the cheapest payoff order by branch and bound. A partial order is
+ *  pruned when even a relaxed continuation of it, which ignores minimum
+ *  payments and pays the highest rate loans first, can't beat the best
+ *  complete order found so far. Threads search depth first from their own
+ *  queue of partial orders and steal the shallowest ones from each other
+ *  when they run out.
+ *  
+ *  If the time limit is hit, the best order so far is returned along with
+ *  a lower bound on the optimum.
+ *  
+ *  @param payoff
+ *  @param config
+ *  @param best_order Output, num_loans loan indices
+ *  @param result Output
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ */
+int payoff_branch_and_bound(payoff_t* payoff, payoff_bnb_config_t* config,
+							unsigned short* best_order, payoff_bnb_result_t* result);
+
+#endif
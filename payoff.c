@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "payoff.h"
+
+/* Balances below this are considered paid off */
+#define PAYOFF_PAID		0.005
+
+int payoff_init(payoff_t* payoff, loan_t* loans, unsigned int num_loans,
+				double budget, unsigned int horizon)
+{
+	unsigned int l;
+
+	// Check required parameters
+	if(payoff == NULL || loans == NULL)
+		return -1;
+	if(num_loans == 0 || num_loans > 65535 || budget <= 0 || horizon == 0)
+		return -2;
+
+	memset(payoff, 0, sizeof(payoff_t));
+
+	payoff->num_loans = num_loans;
+	payoff->budget    = budget;
+	payoff->horizon   = horizon;
+	payoff->loans     = loans;
+
+	payoff->growth = (double*)malloc(sizeof(double) * num_loans);
+	if(payoff->growth == NULL)
+		return -1;
+
+	// Rates are fixed, convert them once
+	for(l = 0; l < num_loans; l++)
+		payoff->growth[l] = 1.0 + loans[l].interest_rate / 12.0 / 100.0;
+
+	// Everything is ready to use
+	payoff->ready = 1;
+
+	return 0;
+}
+
+int payoff_destroy(payoff_t* payoff)
+{
+	if(payoff == NULL)
+		return -1;
+	if(payoff->ready != 1)
+		return -1;
+
+	free(payoff->growth);
+
+	// No longer ready to be used
+	payoff->ready = 0;
+
+	return 0;
+}
+
+void payoff_start(payoff_t* payoff, payoff_state_t* state)
+{
+	unsigned int l;
+
+	state->month = 0;
+	state->carry = 0;
+	state->total = 0;
+	for(l = 0; l < payoff->num_loans; l++)
+		state->balance[l] = payoff->loans[l].principal;
+}
+
+void payoff_copy(payoff_t* payoff, payoff_state_t* dst, const payoff_state_t* src)
+{
+	dst->month = src->month;
+	dst->carry = src->carry;
+	dst->total = src->total;
+	memcpy(dst->balance, src->balance, sizeof(double) * payoff->num_loans);
+}
+
+void payoff_advance(payoff_t* payoff, payoff_state_t* state, unsigned int target)
+{
+	unsigned int l, L = payoff->num_loans;
+	double* balance = state->balance;
+	double b, d, cash, pay;
+
+	assert(target < L);
+
+	// Money left over from the month the last target was paid off in
+	pay = (state->carry < balance[target] ? state->carry : balance[target]);
+	b = balance[target] - pay;
+	balance[target] = (b < PAYOFF_PAID ? 0 : b);
+	state->carry -= pay;
+	state->total += pay;
+
+	while(balance[target] > 0 && state->month < payoff->horizon)
+	{
+		state->month++;
+
+		// Accrue interest and pay the minimum on every other open loan
+		cash = payoff->budget;
+		for(l = 0; l < L; l++) {
+			b = balance[l] * payoff->growth[l];
+			d = (payoff->loans[l].min_payment < b ? payoff->loans[l].min_payment : b);
+			d = (l == target ? 0 : d);
+			b -= d;
+			balance[l] = (b < PAYOFF_PAID ? 0 : b);
+			cash -= d;
+			state->total += d;
+		}
+
+		// Everything else goes to the target
+		if(cash < 0)
+			cash = 0;
+		pay = (cash < balance[target] ? cash : balance[target]);
+		b = balance[target] - pay;
+		balance[target] = (b < PAYOFF_PAID ? 0 : b);
+		state->total += pay;
+		state->carry = cash - pay;
+	}
+}
+
+double payoff_total(payoff_t* payoff, const payoff_state_t* state)
+{
+	unsigned int l;
+	double total = state->total;
+
+	for(l = 0; l < payoff->num_loans; l++)
+		total += state->balance[l];
+
+	return total;
+}
+
+double payoff_evaluate(payoff_t* payoff, const unsigned short* order)
+{
+	payoff_state_t state;
+	unsigned int k;
+	double total;
+
+	assert(payoff->ready == 1);
+
+	state.balance = (double*)malloc(sizeof(double) * payoff->num_loans);
+	if(state.balance == NULL) {
+		fprintf(stderr, "Could not allocate memory\n");
+		abort();
+	}
+
+	payoff_start(payoff, &state);
+	for(k = 0; k < payoff->num_loans; k++)
+		payoff_advance(payoff, &state, order[k]);
+	total = payoff_total(payoff, &state);
+
+	free(state.balance);
+
+	return total;
+}
@@ -0,0 +1,82 @@
+#ifndef PAYOFF_H_
+#define PAYOFF_H_
+
+#include "loan.h"
+
+/*
+ * Payoff order simulation. Every month each open loan gets its minimum
+ * payment and the rest of the budget goes to the first open loan in the
+ * payoff order (the target). Once the target is paid off, what is left of
+ * that month's budget and all later extra money goes to the next loan in the
+ * order, so payments of paid off loans are diverted to the remaining ones.
+ * Avalanche (highest rate first) and snowball (smallest balance first) are
+ * two such orders.
+ */
+typedef struct
+{
+	unsigned int num_loans;
+	double budget;					/// Total monthly payment
+	unsigned int horizon;			/// Months simulated before the rest is due at once
+
+	loan_t* loans;
+	double* growth;					/// Monthly balance growth of each loan
+
+	// Ready flag, everything is properly initialized
+	unsigned int ready;
+} payoff_t;
+
+/*
+ * Simulation state between targets. Everything a later part of the order
+ * needs is in here, so orders sharing a prefix can share its simulation.
+ */
+typedef struct
+{
+	unsigned int month;				/// Months started so far
+	double carry;					/// Budget left over in the current month
+	double total;					/// Total paid so far
+	double* balance;				/// Balance of each loan, num_loans
+} payoff_state_t;
+
+
+/** 
+ *  
+ *  @param payoff
+ *  @param loans Loans to pay off, referenced, not copied
+ *  @param num_loans
+ *  @param budget Total monthly payment
+ *  @param horizon Months simulated, anything owed after that is charged at once
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ *          -2 = invalid configuration
+ */
+int payoff_init(payoff_t* payoff, loan_t* loans, unsigned int num_loans,
+				double budget, unsigned int horizon);
+
+/** 
+ *  
+ *  @param payoff Simulator to destroy
+ *  @return 0 = success, -1 = failure (invalid pointer or input was uninitialized)
+ */
+int payoff_destroy(payoff_t* payoff);
+
+/* Reset a state to the loans' initial balances. state->balance must be allocated. */
+void payoff_start(payoff_t* payoff, payoff_state_t* state);
+
+/* Copy a state, dst->balance must be allocated */
+void payoff_copy(payoff_t* payoff, payoff_state_t* dst, const payoff_state_t* src);
+
+/* Simulate until the target loan is paid off (or the horizon is reached) */
+void payoff_advance(payoff_t* payoff, payoff_state_t* state, unsigned int target);
+
+/* Total paid once every loan has been a target, including anything still owed */
+double payoff_total(payoff_t* payoff, const payoff_state_t* state);
+
+/** 
+ *  Simulate a complete payoff order.
+ *  
+ *  @param payoff
+ *  @param order Every loan index exactly once, first target first
+ *  @return Total amount paid
+ */
+double payoff_evaluate(payoff_t* payoff, const unsigned short* order);
+
+#endif
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "race.h"
+#include "parallel.h"
+
+typedef struct
+{
+	race_engine_t* engines;
+	race_config_t* config;
+	struct timespec start;
+
+	// Shared best so far
+	pthread_mutex_t lock;
+	double* solution;
+	double cost;
+	unsigned int winner;
+
+	unsigned int failed;
+} race_ctx_t;
+
+// Local functions
+static void run_engines(void* ctx, unsigned long int begin, unsigned long int end);
+static double elapsed(const struct timespec* start);
+
+int race_engines(race_engine_t* engines, unsigned int count, race_config_t* config,
+				 double* solution, race_result_t* result)
+{
+	race_ctx_t ctx;
+	unsigned int e;
+
+	// Check required parameters
+	if(engines == NULL || config == NULL || solution == NULL || result == NULL)
+		return -1;
+	if(count == 0 || config->solution_size == 0 || config->deadline <= 0)
+		return -2;
+	for(e = 0; e < count; e++) {
+		if(engines[e].step_fn == NULL || engines[e].best_fn == NULL)
+			return -1;
+		engines[e].state = RACE_RUNNING;
+		engines[e].cost = 1e300;
+		engines[e].steps = 0;
+	}
+
+	memset(&ctx, 0, sizeof(race_ctx_t));
+	ctx.engines = engines;
+	ctx.config = config;
+	ctx.solution = solution;
+	ctx.cost = 1e300;
+	ctx.winner = 0;
+	pthread_mutex_init(&ctx.lock, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &ctx.start);
+
+	// One thread per engine
+	parallel_for(count, count, &run_engines, &ctx);
+
+	pthread_mutex_destroy(&ctx.lock);
+
+	result->cost = ctx.cost;
+	result->winner = ctx.winner;
+	result->elapsed = elapsed(&ctx.start);
+
+	return (ctx.failed ? -1 : 0);
+}
+
+static void run_engines(void* ctx, unsigned long int begin, unsigned long int end)
+{
+	race_ctx_t* r = (race_ctx_t*)ctx;
+	race_config_t* config = r->config;
+	race_engine_t* engine;
+	unsigned long int e;
+	unsigned int more;
+	double* solution;
+	double cost, t;
+
+	solution = (double*)malloc(sizeof(double) * config->solution_size);
+	if(solution == NULL) {
+		__sync_fetch_and_add(&r->failed, 1);
+		return;
+	}
+
+	for(e = begin; e < end; e++)
+	{
+		engine = &r->engines[e];
+		while(engine->state == RACE_RUNNING)
+		{
+			more = engine->step_fn(engine->engine);
+			engine->steps++;
+			cost = engine->best_fn(engine->engine, solution);
+			engine->cost = cost;
+			t = elapsed(&r->start);
+
+			pthread_mutex_lock(&r->lock);
+			if(cost < r->cost) {
+				r->cost = cost;
+				r->winner = e;
+				memcpy(r->solution, solution, sizeof(double) * config->solution_size);
+			}
+
+			// Stop cooperatively, there is no point in chasing a dominant leader
+			if(!more) {
+				engine->state = RACE_DONE;
+			} else if(t >= config->deadline) {
+				engine->state = RACE_STOPPED;
+			} else if(t >= config->grace && cost > r->cost + config->dominance * r->cost) {
+				engine->state = RACE_CANCELLED;
+			}
+			pthread_mutex_unlock(&r->lock);
+		}
+	}
+
+	free(solution);
+}
+
+static double elapsed(const struct timespec* start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
@@ -0,0 +1,63 @@
+#ifndef RACE_H_
+#define RACE_H_
+
+/* Engine states */
+#define RACE_RUNNING		0
+#define RACE_DONE			1	/// Engine finished on its own
+#define RACE_CANCELLED		2	/// Fell too far behind the leader
+#define RACE_STOPPED		3	/// Deadline reached
+
+/*
+ * An optimizer taking part in a race. Engines work in short steps so they
+ * can be stopped between them; a step should take a small fraction of the
+ * deadline. All engines describe solutions the same way, e.g. as payments.
+ */
+typedef struct
+{
+	const char* name;
+	/// Make some progress, return 0 once there is nothing left to do
+	unsigned int (*step_fn)(void* engine);
+	/// Copy the best solution found so far to solution, return its cost
+	double (*best_fn)(void* engine, double* solution);
+	void* engine;					/// Passed through to step_fn and best_fn
+
+	// Filled in by the race
+	unsigned int state;
+	double cost;					/// Cost of the engine's best solution
+	unsigned long int steps;
+} race_engine_t;
+
+typedef struct
+{
+	unsigned int solution_size;		/// # of values in a solution
+	double deadline;				/// Seconds until every engine is stopped
+	double grace;					/// Seconds before engines can be cancelled
+	double dominance;				/// Engines more than this fraction behind the leader are cancelled
+} race_config_t;
+
+typedef struct
+{
+	double cost;					/// Cost of the best solution of all engines
+	unsigned int winner;			/// Engine which found it
+	double elapsed;					/// Seconds taken
+} race_result_t;
+
+
+/**
+ *  Run engines concurrently, one thread each, sharing the best solution so
+ *  far. An engine whose best trails the leader by more than the dominance
+ *  margin after the grace period stops itself, and every engine stops at
+ *  the deadline.
+ *
+ *  @param engines
+ *  @param count # of engines
+ *  @param config
+ *  @param solution Output, solution_size values of the best solution
+ *  @param result Output
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ *          -2 = invalid configuration
+ */
+int race_engines(race_engine_t* engines, unsigned int count, race_config_t* config,
+				 double* solution, race_result_t* result);
+
+#endif
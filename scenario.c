@@ -0,0 +1,515 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "scenario.h"
+#include "parallel.h"
+#include "util.h"
+
+/* Paths are evaluated in blocks of this many scenarios */
+#define SCENARIO_BLOCK		256
+
+/* How often (in months) evaluation checks whether a block is paid off */
+#define SCENARIO_CHECK		12
+
+typedef struct
+{
+	scenario_set_t* set;
+	scenario_config_t* config;
+} generate_ctx_t;
+
+typedef struct
+{
+	scenario_set_t* set;
+	const float* payments;
+	double* totals;
+	unsigned long int offset;		/// First path of the range being split
+	unsigned int unpaid;
+} evaluate_ctx_t;
+
+typedef struct
+{
+	scenario_set_t* set;
+	const float* payments;
+	unsigned int* alive;			/// Plans still in the race
+	double* totals;					/// [plan][scenario] totals evaluated so far
+	unsigned int begin;				/// New paths this round
+	unsigned int end;
+} race_ctx_t;
+
+// Local functions
+static void generate_paths(void* ctx, unsigned long int begin, unsigned long int end);
+static void evaluate_paths(void* ctx, unsigned long int begin, unsigned long int end);
+static void race_paths(void* ctx, unsigned long int begin, unsigned long int end);
+static unsigned int evaluate_range(scenario_set_t* set, const float* payments,
+								   unsigned long int begin, unsigned long int end,
+								   double* totals);
+static double score(scenario_set_t* set, const double* totals, unsigned int n,
+					double* scratch, float tail_weight);
+static void rank_plans(unsigned int* plans, unsigned int count, const double* scores);
+static double tail_mean(double* totals, unsigned int n, unsigned int k);
+static unsigned long long int splitmix64(unsigned long long int* state);
+static double gaussian(unsigned long long int* state);
+
+int scenario_init(scenario_set_t* set, scenario_config_t* config,
+				  loan_t* loans, unsigned int num_loans)
+{
+	generate_ctx_t ctx;
+
+	// Check required parameters
+	if(set == NULL || config == NULL || loans == NULL)
+		return -1;
+	if(	num_loans == 0                ||
+		config->num_scenarios == 0    ||
+		config->horizon == 0          ||
+		config->reversion < 0         ||
+		config->reversion > 1         ||
+		config->correlation < 0       ||
+		config->correlation > 1       ||
+		config->tail_level < 0        ||
+		config->tail_level >= 1 )
+	{
+		return -2;
+	}
+
+	memset(set, 0, sizeof(scenario_set_t));
+
+	set->num_loans     = num_loans;
+	set->num_scenarios = config->num_scenarios;
+	set->horizon       = config->horizon;
+	set->tail_level    = config->tail_level;
+	set->loans         = loans;
+
+	set->growth = (float*)malloc(sizeof(float) * num_loans * config->horizon * config->num_scenarios);
+	if(set->growth == NULL)
+		return -1;
+	if(parallel_pool_init(&set->pool, config->num_threads) != 0) {
+		free(set->growth);
+		set->growth = NULL;
+		return -1;
+	}
+
+	// Each scenario draws from its own stream, so the paths do not depend
+	// on how scenarios are split between threads
+	ctx.set    = set;
+	ctx.config = config;
+	parallel_pool_for(&set->pool, set->num_scenarios, &generate_paths, &ctx);
+
+	// Everything is ready to use
+	set->ready = 1;
+
+	return 0;
+}
+
+int scenario_destroy(scenario_set_t* set)
+{
+	if(set == NULL)
+		return -1;
+	if(set->ready != 1)
+		return -1;
+
+	parallel_pool_destroy(&set->pool);
+	free(set->growth);
+	set->growth = NULL;
+
+	// No longer ready to be used
+	set->ready = 0;
+
+	return 0;
+}
+
+int scenario_evaluate(scenario_set_t* set, const float* payments, scenario_cost_t* cost)
+{
+	unsigned int s, k;
+	double sum, worst;
+	evaluate_ctx_t ctx;
+
+	if(set == NULL || payments == NULL || cost == NULL)
+		return -1;
+	assert(set->ready == 1);
+
+	ctx.set      = set;
+	ctx.payments = payments;
+	ctx.unpaid   = 0;
+	ctx.offset   = 0;
+	ctx.totals   = (double*)malloc(sizeof(double) * set->num_scenarios);
+	if(ctx.totals == NULL)
+		return -1;
+
+	parallel_pool_for(&set->pool, set->num_scenarios, &evaluate_paths, &ctx);
+
+	sum = 0;
+	worst = 0;
+	for(s = 0; s < set->num_scenarios; s++) {
+		sum += ctx.totals[s];
+		if(ctx.totals[s] > worst)
+			worst = ctx.totals[s];
+	}
+
+	// Number of paths in the tail, at least one
+	k = (unsigned int)ceil((1.0 - set->tail_level) * set->num_scenarios);
+	k = COERCE(k, 1, set->num_scenarios);
+
+	cost->expected = sum / set->num_scenarios;
+	cost->worst    = worst;
+	cost->unpaid   = ctx.unpaid;
+	cost->tail     = tail_mean(ctx.totals, set->num_scenarios, k);
+
+	free(ctx.totals);
+
+	return 0;
+}
+
+int scenario_race(scenario_set_t* set, scenario_race_config_t* config,
+				  const float* payments, unsigned int count,
+				  double* scores, unsigned long int* evaluations)
+{
+	unsigned int n, alive, round_paths, prev_paths, rounds = 0;
+	unsigned int kept[33];	// # of plans alive before each round, eta >= 2 so at most 32 cuts
+	double worst, offset;
+	unsigned long int evals = 0;
+	double* scratch;
+	race_ctx_t ctx;
+
+	if(set == NULL || config == NULL || payments == NULL || scores == NULL)
+		return -1;
+	if(config->eta < 2 || config->tail_weight < 0 || config->tail_weight > 1)
+		return -2;
+	assert(set->ready == 1);
+
+	if(count == 0)
+		return 0;
+
+	ctx.set      = set;
+	ctx.payments = payments;
+	ctx.alive    = (unsigned int*)malloc(sizeof(unsigned int) * count);
+	ctx.totals   = (double*)malloc(sizeof(double) * count * set->num_scenarios);
+	scratch      = (double*)malloc(sizeof(double) * set->num_scenarios);
+	if(ctx.alive == NULL || ctx.totals == NULL || scratch == NULL) {
+		free(ctx.alive);
+		free(ctx.totals);
+		free(scratch);
+		return -1;
+	}
+
+	for(n = 0; n < count; n++)
+		ctx.alive[n] = n;
+	alive = count;
+
+	// Every plan starts on the same first paths. Each round, the best 1/eta
+	// of the plans get eta times as many paths, until the survivors have
+	// seen all of them.
+	kept[0] = count;
+	prev_paths = 0;
+	round_paths = COERCE(config->initial_scenarios, 1, set->num_scenarios);
+	while(1)
+	{
+		ctx.begin = prev_paths;
+		ctx.end   = round_paths;
+
+		// Many plans: one thread per plan. Few plans: split the paths.
+		if(alive >= set->pool.num_threads) {
+			parallel_pool_for(&set->pool, alive, &race_paths, &ctx);
+		} else {
+			for(n = 0; n < alive; n++) {
+				evaluate_ctx_t e;
+				e.set      = set;
+				e.payments = &payments[(unsigned long int)ctx.alive[n] * set->num_loans];
+				e.totals   = &ctx.totals[(unsigned long int)ctx.alive[n] * set->num_scenarios];
+				e.offset   = prev_paths;
+				e.unpaid   = 0;
+				parallel_pool_for(&set->pool, round_paths - prev_paths, &evaluate_paths, &e);
+			}
+		}
+		evals += (unsigned long int)alive * (round_paths - prev_paths);
+
+		for(n = 0; n < alive; n++) {
+			scores[ctx.alive[n]] = score( set,
+				&ctx.totals[(unsigned long int)ctx.alive[n] * set->num_scenarios],
+				round_paths, scratch, config->tail_weight );
+		}
+
+		if(round_paths >= set->num_scenarios)
+			break;
+
+		// Keep the leaders
+		rank_plans(ctx.alive, alive, scores);
+		alive = (alive + config->eta - 1) / config->eta;
+		kept[++rounds] = alive;
+
+		prev_paths = round_paths;
+		round_paths = (round_paths * config->eta < set->num_scenarios ?
+					   round_paths * config->eta : set->num_scenarios);
+	}
+
+	// Estimates from fewer paths are more optimistic in the tail, so a plan
+	// dropped early could score better than the survivors. ctx.alive holds
+	// the survivors, then the plans dropped in each round from the last to
+	// the first, best first. Lift each round's plans above all plans ranked
+	// before them, keeping their order within the round.
+	worst = scores[ctx.alive[0]];
+	for(n = 1; n < alive; n++) {
+		if(scores[ctx.alive[n]] > worst)
+			worst = scores[ctx.alive[n]];
+	}
+	while(rounds > 0)
+	{
+		rounds--;
+		if(kept[rounds + 1] == kept[rounds])
+			continue;
+
+		offset = worst - scores[ctx.alive[kept[rounds + 1]]];
+		offset = (offset < 0 ? 0 : offset + 1.0);
+		for(n = kept[rounds + 1]; n < kept[rounds]; n++)
+			scores[ctx.alive[n]] += offset;
+		worst = scores[ctx.alive[kept[rounds] - 1]];
+	}
+
+	if(evaluations != NULL)
+		*evaluations = evals;
+
+	free(scratch);
+	free(ctx.totals);
+	free(ctx.alive);
+
+	return 0;
+}
+
+/*
+ * Generate the rate paths of scenarios [begin:end). Rates follow a mean
+ * reverting random walk around each loan's base rate, with shocks split
+ * between a component shared by all loans (the market index) and a
+ * component of the loan's own. Fixed rate loans get a constant path.
+ */
+static void generate_paths(void* ctx, unsigned long int begin, unsigned long int end)
+{
+	generate_ctx_t* g = (generate_ctx_t*)ctx;
+	scenario_set_t* set = g->set;
+	float reversion = g->config->reversion;
+	double common_w = sqrt(g->config->correlation);
+	double own_w = sqrt(1.0 - g->config->correlation);
+	unsigned long long int state;
+	unsigned long int s, idx;
+	unsigned int l, m;
+	double z, sigma;
+	double* rate;
+
+	rate = (double*)malloc(sizeof(double) * set->num_loans);
+	if(rate == NULL) {
+		fprintf(stderr, "Could not allocate memory\n");
+		abort();
+	}
+
+	for(s = begin; s < end; s++)
+	{
+		state = g->config->seed * 0x9e3779b97f4a7c15ULL + s;
+		splitmix64(&state);
+
+		for(l = 0; l < set->num_loans; l++)
+			rate[l] = set->loans[l].interest_rate;
+
+		for(m = 0; m < set->horizon; m++)
+		{
+			z = gaussian(&state);
+			for(l = 0; l < set->num_loans; l++)
+			{
+				if(set->loans[l].rate_volatility > 0) {
+					sigma = set->loans[l].rate_volatility / sqrt(12.0);
+					rate[l] += reversion * (set->loans[l].interest_rate - rate[l]);
+					rate[l] += sigma * (common_w * z + own_w * gaussian(&state));
+					if(rate[l] < 0)
+						rate[l] = 0;
+				}
+				idx = ((unsigned long int)l * set->horizon + m) * set->num_scenarios + s;
+				set->growth[idx] = 1.0 + rate[l] / 12.0 / 100.0;
+			}
+		}
+	}
+
+	free(rate);
+}
+
+static void evaluate_paths(void* ctx, unsigned long int begin, unsigned long int end)
+{
+	evaluate_ctx_t* e = (evaluate_ctx_t*)ctx;
+	unsigned int unpaid;
+
+	begin += e->offset;
+	end += e->offset;
+	unpaid = evaluate_range(e->set, e->payments, begin, end, &e->totals[begin]);
+	__sync_fetch_and_add(&e->unpaid, unpaid);
+}
+
+/* Evaluate the new paths of the racing plans [begin:end) */
+static void race_paths(void* ctx, unsigned long int begin, unsigned long int end)
+{
+	race_ctx_t* r = (race_ctx_t*)ctx;
+	scenario_set_t* set = r->set;
+	unsigned long int n;
+	unsigned int plan;
+
+	for(n = begin; n < end; n++) {
+		plan = r->alive[n];
+		evaluate_range( set, &r->payments[(unsigned long int)plan * set->num_loans],
+						r->begin, r->end,
+						&r->totals[(unsigned long int)plan * set->num_scenarios + r->begin] );
+	}
+}
+
+/*
+ * Amortize every loan along scenarios [begin:end), writing the total paid on
+ * each path to totals[0:end-begin). The innermost loops run across a block
+ * of scenarios with no data dependent branches, so they compile to vector
+ * code. Returns the # of paths not paid off within the horizon.
+ */
+static unsigned int evaluate_range(scenario_set_t* set, const float* payments,
+								   unsigned long int begin, unsigned long int end,
+								   double* totals)
+{
+	double balance[SCENARIO_BLOCK];
+	double paid[SCENARIO_BLOCK];
+	unsigned int left[SCENARIO_BLOCK];
+	double b, p, payment, principal;
+	unsigned long int b0, s, n;
+	unsigned int l, m, open, unpaid = 0;
+	const float* growth;
+
+	for(b0 = begin; b0 < end; b0 += SCENARIO_BLOCK)
+	{
+		n = (end - b0 < SCENARIO_BLOCK ? end - b0 : SCENARIO_BLOCK);
+
+		for(s = 0; s < n; s++) {
+			totals[b0 - begin + s] = 0;
+			left[s] = 0;
+		}
+
+		for(l = 0; l < set->num_loans; l++)
+		{
+			payment = payments[l];
+			principal = set->loans[l].principal;
+			for(s = 0; s < n; s++) {
+				balance[s] = principal;
+				paid[s] = 0;
+			}
+
+			for(m = 0; m < set->horizon; m++)
+			{
+				growth = &set->growth[((unsigned long int)l * set->horizon + m) * set->num_scenarios + b0];
+				for(s = 0; s < n; s++) {
+					b = balance[s] * growth[s];
+					p = (b < payment ? b : payment);
+					balance[s] = b - p;
+					paid[s] += p;
+				}
+
+				// Stop early once every path in the block is paid off
+				if((m + 1) % SCENARIO_CHECK == 0) {
+					open = 0;
+					for(s = 0; s < n; s++)
+						open |= (balance[s] > 0);
+					if(!open)
+						break;
+				}
+			}
+
+			// Anything left at the horizon is paid off in one go
+			for(s = 0; s < n; s++) {
+				totals[b0 - begin + s] += paid[s] + balance[s];
+				left[s] |= (balance[s] > 0.005);
+			}
+		}
+
+		for(s = 0; s < n; s++)
+			unpaid += left[s];
+	}
+
+	return unpaid;
+}
+
+/* Blended cost of a plan from its totals on the first n paths */
+static double score(scenario_set_t* set, const double* totals, unsigned int n,
+					double* scratch, float tail_weight)
+{
+	unsigned int s, k;
+	double sum = 0;
+
+	for(s = 0; s < n; s++) {
+		sum += totals[s];
+		scratch[s] = totals[s];
+	}
+
+	k = (unsigned int)ceil((1.0 - set->tail_level) * n);
+	k = COERCE(k, 1, n);
+
+	return (1.0 - tail_weight) * (sum / n) + tail_weight * tail_mean(scratch, n, k);
+}
+
+/* Order plan indices by their current score, best first (insertion sort) */
+static void rank_plans(unsigned int* plans, unsigned int count, const double* scores)
+{
+	unsigned int n, m, plan;
+
+	for(n = 1; n < count; n++) {
+		plan = plans[n];
+		for(m = n; m > 0 && scores[plans[m - 1]] > scores[plan]; m--)
+			plans[m] = plans[m - 1];
+		plans[m] = plan;
+	}
+}
+
+/*
+ * Mean of the k largest totals. Partially orders totals in place
+ * (quickselect) so the k largest end up at the back.
+ */
+static double tail_mean(double* totals, unsigned int n, unsigned int k)
+{
+	unsigned int lo = 0, hi = n - 1, target = n - k, i, j;
+	double pivot, t, sum;
+
+	while(lo < hi)
+	{
+		pivot = totals[lo + (hi - lo) / 2];
+		i = lo;
+		j = hi;
+		while(i <= j) {
+			while(totals[i] < pivot) i++;
+			while(totals[j] > pivot) j--;
+			if(i <= j) {
+				t = totals[i]; totals[i] = totals[j]; totals[j] = t;
+				i++;
+				if(j == 0)
+					break;
+				j--;
+			}
+		}
+		if(target <= j)
+			hi = j;
+		else if(target >= i)
+			lo = i;
+		else
+			break;
+	}
+
+	sum = 0;
+	for(i = target; i < n; i++)
+		sum += totals[i];
+	return sum / k;
+}
+
+static unsigned long long int splitmix64(unsigned long long int* state)
+{
+	unsigned long long int z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* Standard normal deviate (Box-Muller) */
+static double gaussian(unsigned long long int* state)
+{
+	double u1 = ((splitmix64(state) >> 11) + 1) * (1.0 / 9007199254740993.0);
+	double u2 = (splitmix64(state) >> 11) * (1.0 / 9007199254740992.0);
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
@@ -0,0 +1,111 @@
+#ifndef SCENARIO_H_
+#define SCENARIO_H_
+
+#include "loan.h"
+#include "parallel.h"
+
+typedef struct
+{
+	unsigned int num_scenarios;		/// # of rate paths generated per loan
+	unsigned int horizon;			/// # of months simulated per path
+	float reversion;				/// Monthly pull of a rate back to its base [0:1]
+	float correlation;				/// Share of rate shocks common to all loans [0:1]
+	float tail_level;				/// Tail cost averages the worst (1 - level) paths [0:1)
+	unsigned int num_threads;		/// Evaluation threads, 0 = one per CPU
+	unsigned long int seed;			/// Same seed produces the same paths
+} scenario_config_t;
+
+typedef struct
+{
+	unsigned int num_loans;
+	unsigned int num_scenarios;
+	unsigned int horizon;
+	float tail_level;
+
+	// Threads evaluating the paths, kept from scenario_init to scenario_destroy
+	parallel_pool_t pool;
+
+	// Loans the paths were generated for
+	loan_t* loans;
+
+	// Monthly balance growth factors (1 + monthly rate), laid out as
+	// [loan][month][scenario] so evaluation streams over scenarios
+	float* growth;
+
+	// Ready flag, everything is properly initialized
+	unsigned int ready;
+} scenario_set_t;
+
+typedef struct
+{
+	double expected;				/// Mean total paid over all paths
+	double tail;					/// Mean total paid over the worst paths (CVaR)
+	double worst;					/// Largest total paid over all paths
+	unsigned int unpaid;			/// # of paths not paid off within the horizon
+} scenario_cost_t;
+
+typedef struct
+{
+	unsigned int initial_scenarios;	/// # of paths every plan is evaluated on first
+	unsigned int eta;				/// Each round keeps the best 1/eta of the plans [2:]
+	float tail_weight;				/// Score = (1 - w) * expected + w * tail [0:1]
+} scenario_race_config_t;
+
+
+/** 
+ *  Generate interest rate paths for every loan. Paths are fixed once
+ *  generated, so every payment plan is evaluated against the same draws
+ *  (common random numbers) and plans can be compared without sampling noise.
+ *  
+ *  @param set Scenario set to initialize
+ *  @param config
+ *  @param loans Loans to generate paths for, referenced, not copied
+ *  @param num_loans
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ *          -2 = invalid configuration
+ */
+int scenario_init(scenario_set_t* set, scenario_config_t* config,
+				  loan_t* loans, unsigned int num_loans);
+
+/** 
+ *  
+ *  @param set Scenario set to destroy
+ *  @return 0 = success, -1 = failure (invalid pointer or input was uninitialized)
+ */
+int scenario_destroy(scenario_set_t* set);
+
+/** 
+ *  Evaluate the total amount paid by a plan of fixed monthly payments
+ *  on every path. A path which is not paid off within the horizon is charged
+ *  its outstanding balance as a final payment.
+ *  
+ *  @param set
+ *  @param payments Monthly payment for each loan
+ *  @param cost Output statistics
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ */
+int scenario_evaluate(scenario_set_t* set, const float* payments, scenario_cost_t* cost);
+
+/** 
+ *  Score a batch of plans by successive halving. All plans are evaluated on
+ *  the first initial_scenarios paths; each round the best 1/eta of the
+ *  remaining plans are evaluated on eta times as many paths, until the
+ *  survivors have seen every path. Because all plans share the same paths,
+ *  early rounds rank plans reliably with far fewer path evaluations.
+ *  
+ *  @param set
+ *  @param config
+ *  @param payments count rows of num_loans monthly payments
+ *  @param count # of plans
+ *  @param scores Output score of each plan (lower is better). Plans dropped
+ *                in a round score above every plan that outlasted them, so
+ *                scores order plans but are only costs for the survivors.
+ *  @param evaluations Output # of path evaluations spent, may be NULL
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ *          -2 = invalid configuration
+ */
+int scenario_race(scenario_set_t* set, scenario_race_config_t* config,
+				  const float* payments, unsigned int count,
+				  double* scores, unsigned long int* evaluations);
+
+#endif
@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "schedule.h"
+
+/* Balances below this are considered paid off */
+#define SCHEDULE_PAID		0.005
+
+/* Evaluation state kept between evaluations of the same individual */
+typedef struct
+{
+	unsigned int done_period;		/// All loans are paid off before this period
+	double total;					/// Total paid by the cached schedule
+} schedule_cache_t;
+
+// Local functions
+static double* checkpoint(schedule_t* schedule, void* cache, unsigned int period);
+
+int schedule_init(schedule_t* schedule, loan_t* loans, unsigned int num_loans,
+				  unsigned int num_periods, unsigned int period_months,
+				  const float* budget)
+{
+	unsigned int l, m, loan;
+
+	// Check required parameters
+	if(schedule == NULL || loans == NULL || budget == NULL)
+		return -1;
+	if(num_loans == 0 || num_periods == 0 || period_months == 0)
+		return -2;
+
+	memset(schedule, 0, sizeof(schedule_t));
+
+	schedule->num_loans     = num_loans;
+	schedule->num_periods   = num_periods;
+	schedule->period_months = period_months;
+	schedule->num_months    = num_periods * period_months;
+	schedule->loans         = loans;
+
+	schedule->budget  = (float*)malloc(sizeof(float) * schedule->num_months);
+	schedule->growth  = (double*)malloc(sizeof(double) * num_loans);
+	schedule->by_rate = (unsigned int*)malloc(sizeof(unsigned int) * num_loans);
+	if(schedule->budget == NULL || schedule->growth == NULL || schedule->by_rate == NULL) {
+		free(schedule->budget);
+		free(schedule->growth);
+		free(schedule->by_rate);
+		return -1;
+	}
+
+	memcpy(schedule->budget, budget, sizeof(float) * schedule->num_months);
+
+	// Rates are fixed, convert them once
+	for(l = 0; l < num_loans; l++)
+		schedule->growth[l] = 1.0 + loans[l].interest_rate / 12.0 / 100.0;
+
+	// Overpayments go to the most expensive open loan first
+	for(l = 0; l < num_loans; l++) {
+		loan = l;
+		for(m = l; m > 0 && schedule->growth[schedule->by_rate[m - 1]] < schedule->growth[loan]; m--)
+			schedule->by_rate[m] = schedule->by_rate[m - 1];
+		schedule->by_rate[m] = loan;
+	}
+
+	// Everything is ready to use
+	schedule->ready = 1;
+
+	return 0;
+}
+
+int schedule_destroy(schedule_t* schedule)
+{
+	if(schedule == NULL)
+		return -1;
+	if(schedule->ready != 1)
+		return -1;
+
+	free(schedule->budget);
+	free(schedule->growth);
+	free(schedule->by_rate);
+
+	// No longer ready to be used
+	schedule->ready = 0;
+
+	return 0;
+}
+
+unsigned long int schedule_genome_size(schedule_t* schedule)
+{
+	return (unsigned long int)schedule->num_periods * schedule->num_loans;
+}
+
+unsigned long int schedule_cache_size(schedule_t* schedule)
+{
+	// Header, then balances and total paid at the start of every period
+	return sizeof(schedule_cache_t) +
+		   sizeof(double) * (unsigned long int)schedule->num_periods * (schedule->num_loans + 1);
+}
+
+double schedule_evaluate(schedule_t* schedule, const float* genes,
+						 void* cache, unsigned int first_period,
+						 float* payments)
+{
+	schedule_cache_t* header = (schedule_cache_t*)cache;
+	unsigned int L = schedule->num_loans;
+	unsigned int l, p, mm, month, start, done, open, nopen;
+	double total, b, d, pay, over, extra, scale, left, wl, wsum, mins;
+	double *balance, *due, *weight, *state;
+	const float* g;
+
+	assert(schedule->ready == 1);
+
+	// Payments are not part of the cache, simulate everything
+	if(payments != NULL)
+		first_period = 0;
+
+	// Nothing changed before every loan was paid off
+	if(header != NULL && first_period > 0 && first_period >= header->done_period)
+		return header->total;
+
+	balance = (double*)malloc(sizeof(double) * L * 3);
+	if(balance == NULL) {
+		fprintf(stderr, "Could not allocate memory\n");
+		abort();
+	}
+	due = balance + L;
+	weight = due + L;
+
+	// Resume from the last state before the first change
+	if(header != NULL && first_period > 0) {
+		start = first_period;
+		state = checkpoint(schedule, cache, start);
+		memcpy(balance, state, sizeof(double) * L);
+		total = state[L];
+	} else {
+		start = 0;
+		for(l = 0; l < L; l++)
+			balance[l] = schedule->loans[l].principal;
+		total = 0;
+	}
+
+	if(payments != NULL)
+		memset(payments, 0, sizeof(float) * schedule->num_months * L);
+
+	done = schedule->num_periods;
+	for(p = start; p < schedule->num_periods && done == schedule->num_periods; p++)
+	{
+		if(header != NULL) {
+			state = checkpoint(schedule, cache, p);
+			memcpy(state, balance, sizeof(double) * L);
+			state[L] = total;
+		}
+
+		g = &genes[(unsigned long int)p * L];
+		for(mm = 0; mm < schedule->period_months; mm++)
+		{
+			month = p * schedule->period_months + mm;
+
+			// Accrue interest and work out minimum payments and weights
+			mins = 0;
+			wsum = 0;
+			nopen = 0;
+			for(l = 0; l < L; l++) {
+				b = balance[l] * schedule->growth[l];
+				balance[l] = b;
+				open = (b > 0);
+				d = (schedule->loans[l].min_payment < b ? schedule->loans[l].min_payment : b);
+				due[l] = d;
+				mins += d;
+				wl = (open ? g[l] : 0.0);
+				weight[l] = wl;
+				wsum += wl;
+				nopen += open;
+			}
+
+			// Later genes can't change anything once every loan is paid off
+			if(nopen == 0) {
+				done = (mm == 0 ? p : p + 1);
+				break;
+			}
+
+			// All weights zero, split evenly
+			if(wsum <= 0) {
+				for(l = 0; l < L; l++)
+					weight[l] = (balance[l] > 0);
+				wsum = nopen;
+			}
+
+			extra = schedule->budget[month] - mins;
+			if(extra < 0)
+				extra = 0;
+			scale = extra / wsum;
+
+			left = 0;
+			for(l = 0; l < L; l++) {
+				pay = due[l] + weight[l] * scale;
+				over = (pay > balance[l] ? pay - balance[l] : 0);
+				pay -= over;
+				left += over;
+				b = balance[l] - pay;
+				balance[l] = (b < SCHEDULE_PAID ? 0 : b);
+				due[l] = pay;
+				total += pay;
+			}
+
+			// Overpayments go to the most expensive open loans
+			for(l = 0; l < L && left > 0; l++) {
+				b = balance[schedule->by_rate[l]];
+				pay = (left < b ? left : b);
+				b -= pay;
+				balance[schedule->by_rate[l]] = (b < SCHEDULE_PAID ? 0 : b);
+				due[schedule->by_rate[l]] += pay;
+				left -= pay;
+				total += pay;
+			}
+
+			if(payments != NULL) {
+				for(l = 0; l < L; l++)
+					payments[(unsigned long int)month * L + l] = due[l];
+			}
+		}
+	}
+
+	// Anything left at the end is paid off in one go
+	for(l = 0; l < L; l++)
+		total += balance[l];
+
+	if(header != NULL) {
+		header->done_period = done;
+		header->total = total;
+	}
+
+	free(balance);
+
+	return total;
+}
+
+int schedule_upsample(schedule_t* coarse, const float* coarse_genes,
+					  schedule_t* fine, float* fine_genes)
+{
+	unsigned int p, ratio;
+
+	if(coarse == NULL || coarse_genes == NULL || fine == NULL || fine_genes == NULL)
+		return -1;
+	if(	coarse->num_loans != fine->num_loans   ||
+		coarse->num_months != fine->num_months ||
+		coarse->period_months % fine->period_months != 0 )
+	{
+		return -2;
+	}
+
+	ratio = coarse->period_months / fine->period_months;
+	for(p = 0; p < fine->num_periods; p++) {
+		memcpy( &fine_genes[(unsigned long int)p * fine->num_loans],
+				&coarse_genes[(unsigned long int)(p / ratio) * coarse->num_loans],
+				sizeof(float) * fine->num_loans );
+	}
+
+	return 0;
+}
+
+/* Balances and total paid at the start of a period */
+static double* checkpoint(schedule_t* schedule, void* cache, unsigned int period)
+{
+	double* states = (double*)((unsigned char*)cache + sizeof(schedule_cache_t));
+	return &states[(unsigned long int)period * (schedule->num_loans + 1)];
+}
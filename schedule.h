@@ -0,0 +1,97 @@
+#ifndef SCHEDULE_H_
+#define SCHEDULE_H_
+
+#include "loan.h"
+
+/*
+ * A payment schedule splits a (possibly changing) monthly budget between
+ * loans, with a separate split for every period of period_months months.
+ * The genes of period p are genes[p * num_loans : (p + 1) * num_loans), one
+ * weight in [0:1) per loan. Each month every open loan gets its minimum
+ * payment, and what is left of the budget is split between the open loans
+ * in proportion to their weights. Money which would overpay a loan goes to
+ * the open loan with the highest rate.
+ */
+typedef struct
+{
+	unsigned int num_loans;
+	unsigned int num_periods;		/// # of periods in the plan
+	unsigned int period_months;		/// Months per period (1 = monthly, 3 = quarterly...)
+	unsigned int num_months;		/// num_periods * period_months
+
+	loan_t* loans;
+	float* budget;					/// Total payment available in each month
+	double* growth;					/// Monthly balance growth of each loan
+	unsigned int* by_rate;			/// Loans from highest to lowest rate
+
+	// Ready flag, everything is properly initialized
+	unsigned int ready;
+} schedule_t;
+
+/** 
+ *  
+ *  @param schedule
+ *  @param loans Loans to schedule payments for, referenced, not copied
+ *  @param num_loans
+ *  @param num_periods
+ *  @param period_months
+ *  @param budget Total payment available in each of the num_periods *
+ *                period_months months, copied
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ *          -2 = invalid configuration
+ */
+int schedule_init(schedule_t* schedule, loan_t* loans, unsigned int num_loans,
+				  unsigned int num_periods, unsigned int period_months,
+				  const float* budget);
+
+/** 
+ *  
+ *  @param schedule Schedule to destroy
+ *  @return 0 = success, -1 = failure (invalid pointer or input was uninitialized)
+ */
+int schedule_destroy(schedule_t* schedule);
+
+/* Number of genes of a schedule */
+unsigned long int schedule_genome_size(schedule_t* schedule);
+
+/* Bytes of evaluation state needed for incremental evaluation */
+unsigned long int schedule_cache_size(schedule_t* schedule);
+
+/** 
+ *  Simulate a schedule month by month and return the total amount paid.
+ *  Anything still owed at the end of the last period is charged as a final
+ *  payment.
+ *  
+ *  With a cache, the state at the start of every period is recorded, and a
+ *  later evaluation whose genes only changed from first_period on resumes
+ *  from there. Changes to periods after all loans are paid off cost nothing.
+ *  
+ *  @param schedule
+ *  @param genes Schedule genes, see schedule_t
+ *  @param cache schedule_cache_size() bytes, or NULL to always simulate fully
+ *  @param first_period First period whose genes changed since the cache was
+ *                      written (0 = cache is empty or stale)
+ *  @param payments Output payment to each loan in every month, num_months
+ *                  rows of num_loans, may be NULL. Final payments of loans
+ *                  still open after the last month are not included.
+ *  @return Total amount paid
+ */
+double schedule_evaluate(schedule_t* schedule, const float* genes,
+						 void* cache, unsigned int first_period,
+						 float* payments);
+
+/** 
+ *  Convert schedule genes to a finer schedule of the same loans and length.
+ *  Every fine period takes the split of the coarse period it falls in.
+ *  
+ *  @param coarse
+ *  @param coarse_genes
+ *  @param fine Periods must evenly divide the coarse periods
+ *  @param fine_genes Output, schedule_genome_size(fine) genes
+ *  @return 0 = success, -1 = failure (invalid input pointer)
+ *          -2 = schedules don't match
+ */
+int schedule_upsample(schedule_t* coarse, const float* coarse_genes,
+					  schedule_t* fine, float* fine_genes);
+
+#endif
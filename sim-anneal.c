@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "sim-anneal.h"
+
+// Local functions
+static void keep_best(sim_anneal_t* sa);
+static inline unsigned long long int rng_next(sim_anneal_t* sa);
+static inline double rng_unit(sim_anneal_t* sa);
+
+int sim_anneal_init(sim_anneal_t* sa, sim_anneal_config_t* config, const double* start)
+{
+	unsigned int i;
+
+	// Check required parameters
+	if(sa == NULL || config == NULL || start == NULL || config->cost_fn == NULL)
+		return -1;
+	if(	config->size < 2 || config->num_moves == 0 || config->initial_temp < 0 ||
+		config->final_temp < 0 || config->initial_step <= 0 || config->final_step <= 0 )
+	{
+		return -2;
+	}
+
+	memset(sa, 0, sizeof(sim_anneal_t));
+
+	sa->size      = config->size;
+	sa->lower     = config->lower;
+	sa->cost_fn   = config->cost_fn;
+	sa->user_data = config->user_data;
+	sa->num_moves = config->num_moves;
+	sa->rng_state = config->seed;
+
+	// Geometric schedules from the initial to the final values
+	sa->temp = config->initial_temp;
+	sa->temp_factor = 1.0;
+	if(config->initial_temp > 0 && config->final_temp > 0)
+		sa->temp_factor = pow(config->final_temp / config->initial_temp, 1.0 / config->num_moves);
+	sa->step = config->initial_step;
+	sa->step_factor = pow(config->final_step / config->initial_step, 1.0 / config->num_moves);
+
+	sa->values = (double*)malloc(sizeof(double) * sa->size * 3);
+	if(sa->values == NULL)
+		return -1;
+	sa->costs = sa->values + sa->size;
+	sa->best = sa->costs + sa->size;
+
+	memcpy(sa->values, start, sizeof(double) * sa->size);
+	sa->cost = 0;
+	for(i = 0; i < sa->size; i++) {
+		sa->costs[i] = sa->cost_fn(i, sa->values[i], sa->user_data);
+		sa->cost += sa->costs[i];
+	}
+	memcpy(sa->best, sa->values, sizeof(double) * sa->size);
+	sa->best_cost = sa->cost;
+
+	// Everything is ready to use
+	sa->ready = 1;
+
+	return 0;
+}
+
+int sim_anneal_destroy(sim_anneal_t* sa)
+{
+	if(sa == NULL)
+		return -1;
+	if(sa->ready != 1)
+		return -1;
+
+	free(sa->values);
+
+	// No longer ready to be used
+	sa->ready = 0;
+
+	return 0;
+}
+
+unsigned long int sim_anneal_run(sim_anneal_t* sa, unsigned long int count)
+{
+	unsigned long int made;
+	unsigned int i, j;
+	double amount, room, a, b, ca, cb, delta;
+
+	assert(sa->ready == 1);
+
+	for(made = 0; made < count && sa->move < sa->num_moves; made++)
+	{
+		sa->move++;
+
+		// Move up to step from j to i
+		i = rng_next(sa) % sa->size;
+		j = rng_next(sa) % (sa->size - 1);
+		j += (j >= i);
+
+		amount = sa->step * rng_unit(sa);
+		room = sa->values[j] - (sa->lower != NULL ? sa->lower[j] : 0.0);
+		if(amount > room)
+			amount = room;
+
+		sa->temp *= sa->temp_factor;
+		sa->step *= sa->step_factor;
+		if(amount <= 0)
+			continue;
+
+		// Only the two changed values are re-evaluated
+		a = sa->values[i] + amount;
+		b = sa->values[j] - amount;
+		ca = sa->cost_fn(i, a, sa->user_data);
+		cb = sa->cost_fn(j, b, sa->user_data);
+		delta = (ca + cb) - (sa->costs[i] + sa->costs[j]);
+
+		// Between two infeasible solutions, drift freely
+		if(isnan(delta))
+			delta = 0;
+
+		// Metropolis criterion
+		if(delta > 0 && (sa->temp <= 0 || rng_unit(sa) >= exp(-delta / sa->temp)))
+			continue;
+
+		sa->values[i] = a;
+		sa->values[j] = b;
+		sa->costs[i] = ca;
+		sa->costs[j] = cb;
+		sa->cost += delta;
+		sa->accepted++;
+
+		// Leaving or entering infeasibility, the running sum can't be trusted
+		if(!isfinite(delta) || !isfinite(sa->cost)) {
+			sa->cost = 0;
+			for(i = 0; i < sa->size; i++)
+				sa->cost += sa->costs[i];
+		}
+	}
+
+	keep_best(sa);
+
+	return made;
+}
+
+/*
+ * Snapshot the solution if it is the best so far. Only done between slices,
+ * copying every value on each improving move would cost O(size) per move.
+ */
+static void keep_best(sim_anneal_t* sa)
+{
+	unsigned int i;
+
+	// Start the next slice without rounding drift
+	sa->cost = 0;
+	for(i = 0; i < sa->size; i++)
+		sa->cost += sa->costs[i];
+
+	if(sa->cost < sa->best_cost) {
+		memcpy(sa->best, sa->values, sizeof(double) * sa->size);
+		sa->best_cost = sa->cost;
+	}
+}
+
+/* splitmix64 */
+static inline unsigned long long int rng_next(sim_anneal_t* sa)
+{
+	unsigned long long int z = (sa->rng_state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* Uniform in [0:1) */
+static inline double rng_unit(sim_anneal_t* sa)
+{
+	return (rng_next(sa) >> 11) * (1.0 / 9007199254740992.0);
+}
@@ -0,0 +1,84 @@
+#ifndef SIM_ANNEAL_H_
+#define SIM_ANNEAL_H_
+
+/*
+ * Simulated annealing over a vector of values with a fixed sum, e.g. the
+ * monthly payment of every loan. A move takes an amount from one value and
+ * gives it to another. The cost has to be a sum of one term per value, so
+ * a move only re-evaluates the two values it changes.
+ */
+typedef double (*sim_anneal_cost_fn)(unsigned int index, double value, void* user_data);
+
+typedef struct
+{
+	unsigned int size;				/// # of values
+	const double* lower;			/// Smallest allowed value of each, NULL = 0
+	double initial_temp;			/// Temperature of the first move, 0 = only improve
+	double final_temp;				/// Temperature of the last move
+	double initial_step;			/// Largest amount moved at first
+	double final_step;				/// Largest amount moved at the end
+	unsigned long int num_moves;	/// Length of the cooling schedule
+	sim_anneal_cost_fn cost_fn;		/// Cost of one value, may return HUGE_VAL
+	void* user_data;				/// Passed through to cost_fn
+	unsigned long long int seed;	/// Same seed makes the same moves
+} sim_anneal_config_t;
+
+typedef struct
+{
+	unsigned int size;
+	const double* lower;
+	sim_anneal_cost_fn cost_fn;
+	void* user_data;
+
+	// Cooling schedule, both shrink geometrically every move
+	unsigned long int num_moves;
+	unsigned long int move;			/// Moves made so far
+	double temp;
+	double temp_factor;
+	double step;
+	double step_factor;
+
+	// Current and best solutions
+	double* values;
+	double* costs;					/// Cost of each value
+	double cost;					/// Sum of costs
+	double* best;					/// Best solution seen between slices
+	double best_cost;
+
+	unsigned long int accepted;		/// # of moves kept
+
+	unsigned long long int rng_state;
+
+	// Ready flag, everything is properly initialized
+	unsigned int ready;
+} sim_anneal_t;
+
+
+/**
+ *
+ *  @param sa
+ *  @param config
+ *  @param start size initial values, their sum is kept by every move
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ *          -2 = invalid configuration
+ */
+int sim_anneal_init(sim_anneal_t* sa, sim_anneal_config_t* config, const double* start);
+
+/**
+ *
+ *  @param sa Annealer to destroy
+ *  @return 0 = success, -1 = failure (invalid pointer or input was uninitialized)
+ */
+int sim_anneal_destroy(sim_anneal_t* sa);
+
+/**
+ *  Continue the cooling schedule, so a long schedule can be run in slices.
+ *  The best solution is updated at the end of every slice.
+ *
+ *  @param sa
+ *  @param count Most moves to make
+ *  @return # of moves made, 0 once the schedule is complete
+ */
+unsigned long int sim_anneal_run(sim_anneal_t* sa, unsigned long int count);
+
+#endif
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "surrogate.h"
+
+/* Added to the kernel matrix diagonal, keeps close genomes from making it singular */
+#define SURROGATE_RIDGE		1e-6
+
+// Local functions
+static double distance2(const float* a, const float* b, unsigned long int dim);
+
+int surrogate_init(surrogate_t* s, unsigned long int dim, unsigned int capacity)
+{
+	// Check required parameters
+	if(s == NULL)
+		return -1;
+	if(dim == 0 || capacity < 3)
+		return -2;
+
+	memset(s, 0, sizeof(surrogate_t));
+
+	s->dim      = dim;
+	s->capacity = capacity;
+
+	s->x       = (float*)malloc(sizeof(float) * dim * capacity);
+	s->y       = (double*)malloc(sizeof(double) * capacity);
+	s->weights = (double*)malloc(sizeof(double) * capacity);
+	s->chol    = (double*)malloc(sizeof(double) * capacity * capacity);
+	if(s->x == NULL || s->y == NULL || s->weights == NULL || s->chol == NULL) {
+		free(s->x);
+		free(s->y);
+		free(s->weights);
+		free(s->chol);
+		return -1;
+	}
+
+	// Everything is ready to use
+	s->ready = 1;
+
+	return 0;
+}
+
+int surrogate_destroy(surrogate_t* s)
+{
+	if(s == NULL)
+		return -1;
+	if(s->ready != 1)
+		return -1;
+
+	free(s->x);
+	free(s->y);
+	free(s->weights);
+	free(s->chol);
+
+	// No longer ready to be used
+	s->ready = 0;
+
+	return 0;
+}
+
+void surrogate_add(surrogate_t* s, const float* x, double y)
+{
+	unsigned int i;
+
+	assert(s->ready == 1);
+
+	// The same genome twice would make the kernel matrix singular
+	for(i = 0; i < s->count; i++) {
+		if(memcmp(&s->x[i * s->dim], x, sizeof(float) * s->dim) == 0)
+			return;
+	}
+
+	memcpy(&s->x[s->next * s->dim], x, sizeof(float) * s->dim);
+	s->y[s->next] = y;
+	s->next = (s->next + 1) % s->capacity;
+	if(s->count < s->capacity)
+		s->count++;
+
+	s->fitted = 0;
+}
+
+int surrogate_fit(surrogate_t* s)
+{
+	unsigned int n = s->count, i, j, k;
+	double* L = s->chol;
+	double d, sum, pairs;
+
+	assert(s->ready == 1);
+
+	s->fitted = 0;
+	if(n < 3)
+		return -1;
+
+	// Kernel width is the mean distance between kept genomes
+	s->mean = 0;
+	sum = 0;
+	pairs = 0;
+	for(i = 0; i < n; i++) {
+		s->mean += s->y[i];
+		for(j = 0; j < i; j++) {
+			d = distance2(&s->x[i * s->dim], &s->x[j * s->dim], s->dim);
+			L[i * n + j] = d;
+			sum += sqrt(d);
+			pairs++;
+		}
+	}
+	s->mean /= n;
+	s->width = sum / pairs;
+	if(s->width <= 0)
+		return -1;
+
+	// Lower triangle of the kernel matrix, then its Cholesky factor in place
+	for(i = 0; i < n; i++) {
+		for(j = 0; j < i; j++)
+			L[i * n + j] = exp(-L[i * n + j] / (s->width * s->width));
+		L[i * n + i] = 1.0 + SURROGATE_RIDGE;
+	}
+	for(j = 0; j < n; j++)
+	{
+		sum = L[j * n + j];
+		for(k = 0; k < j; k++)
+			sum -= L[j * n + k] * L[j * n + k];
+		if(sum <= 0)
+			return -1;
+		L[j * n + j] = sqrt(sum);
+
+		for(i = j + 1; i < n; i++) {
+			sum = L[i * n + j];
+			for(k = 0; k < j; k++)
+				sum -= L[i * n + k] * L[j * n + k];
+			L[i * n + j] = sum / L[j * n + j];
+		}
+	}
+
+	// Weights interpolate the fitness around its mean, L L' w = y - mean
+	for(i = 0; i < n; i++) {
+		sum = s->y[i] - s->mean;
+		for(k = 0; k < i; k++)
+			sum -= L[i * n + k] * s->weights[k];
+		s->weights[i] = sum / L[i * n + i];
+	}
+	for(i = n; i-- > 0; ) {
+		sum = s->weights[i];
+		for(k = i + 1; k < n; k++)
+			sum -= L[k * n + i] * s->weights[k];
+		s->weights[i] = sum / L[i * n + i];
+	}
+
+	s->fitted = 1;
+
+	return 0;
+}
+
+double surrogate_predict(surrogate_t* s, const float* x)
+{
+	unsigned int i;
+	double f = s->mean;
+
+	assert(s->fitted == 1);
+
+	for(i = 0; i < s->count; i++)
+		f += s->weights[i] * exp(-distance2(&s->x[i * s->dim], x, s->dim) / (s->width * s->width));
+
+	return f;
+}
+
+static double distance2(const float* a, const float* b, unsigned long int dim)
+{
+	unsigned long int i;
+	double d, sum = 0;
+
+	for(i = 0; i < dim; i++) {
+		d = (double)a[i] - b[i];
+		sum += d * d;
+	}
+
+	return sum;
+}
@@ -0,0 +1,60 @@
+#ifndef SURROGATE_H_
+#define SURROGATE_H_
+
+/*
+ * Gaussian radial basis function model of a fitness function, interpolating
+ * the most recently evaluated genomes. Far from every known genome it
+ * predicts their mean fitness.
+ */
+typedef struct
+{
+	unsigned long int dim;			/// # of genes
+	unsigned int capacity;			/// Most genomes kept, the oldest are replaced
+	unsigned int count;				/// Genomes kept so far
+	unsigned int next;				/// Slot the next genome goes to
+
+	float* x;						/// Genomes, capacity * dim
+	double* y;						/// Their fitness
+	double* weights;				/// Kernel weights of the fitted model
+	double* chol;					/// Cholesky factor of the kernel matrix, capacity^2
+	double width;					/// Kernel width
+	double mean;					/// Mean fitness of the kept genomes
+	unsigned int fitted;			/// Model is up to date with the kept genomes
+
+	// Ready flag, everything is properly initialized
+	unsigned int ready;
+} surrogate_t;
+
+
+/**
+ *
+ *  @param s
+ *  @param dim # of genes per genome
+ *  @param capacity # of evaluated genomes to interpolate
+ *  @return 0 = success, -1 = failure (allocation error or invalid input pointer)
+ *          -2 = invalid configuration
+ */
+int surrogate_init(surrogate_t* s, unsigned long int dim, unsigned int capacity);
+
+/**
+ *
+ *  @param s Model to destroy
+ *  @return 0 = success, -1 = failure (invalid pointer or input was uninitialized)
+ */
+int surrogate_destroy(surrogate_t* s);
+
+/* Remember an evaluated genome. Genomes which are already kept are ignored. */
+void surrogate_add(surrogate_t* s, const float* x, double y);
+
+/**
+ *  Fit the model to the kept genomes.
+ *
+ *  @param s
+ *  @return 0 = success, -1 = too few genomes or the fit failed
+ */
+int surrogate_fit(surrogate_t* s);
+
+/* Predicted fitness of a genome, the model must be fitted */
+double surrogate_predict(surrogate_t* s, const float* x);
+
+#endif
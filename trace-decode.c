@@ -0,0 +1,87 @@
+/*
+ * Print a trace file written by trace.c as text, one event per line,
+ * prefixed with the number of the thread which recorded it.
+ *
+ * Usage: trace-decode <trace file>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+static void print_event(unsigned int thread, const trace_event_t* e);
+
+int main(int argc, char* argv[])
+{
+	FILE* f;
+	trace_chunk_t chunk;
+	trace_event_t* events;
+	unsigned long int total = 0;
+	unsigned int n;
+
+	if(argc != 2) {
+		fprintf(stderr, "Usage: %s <trace file>\n", argv[0]);
+		return 1;
+	}
+
+	f = fopen(argv[1], "rb");
+	if(f == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	events = (trace_event_t*)malloc(sizeof(trace_event_t) * TRACE_CHUNK_EVENTS);
+	if(events == NULL) {
+		fclose(f);
+		return 1;
+	}
+
+	while(fread(&chunk, sizeof(chunk), 1, f) == 1)
+	{
+		if(	chunk.magic != TRACE_MAGIC || chunk.count > TRACE_CHUNK_EVENTS ||
+			fread(events, sizeof(trace_event_t), chunk.count, f) != chunk.count )
+		{
+			fprintf(stderr, "%s: corrupt chunk after %lu events\n", argv[1], total);
+			break;
+		}
+
+		for(n = 0; n < chunk.count; n++)
+			print_event(chunk.thread, &events[n]);
+		total += chunk.count;
+	}
+
+	free(events);
+	fclose(f);
+	return 0;
+}
+
+static void print_event(unsigned int thread, const trace_event_t* e)
+{
+	printf("%u\t", thread);
+
+	switch(e->type)
+	{
+		case TRACE_GENERATION:
+			printf("generation %u\treplaced %u\tfittest %u\tfitness %g\n", e->a, e->b, e->c, e->value);
+			break;
+		case TRACE_EVALUATE:
+			printf("evaluate %u\tfitness %g\n", e->a, e->value);
+			break;
+		case TRACE_PARENTS:
+			printf("parents %u\tmother %u\tfather %u\n", e->a, e->b, e->c);
+			break;
+		case TRACE_CHILD:
+			printf("child %u\tfirst changed %u\thash %08x\n", e->a, e->b, e->c);
+			break;
+		case TRACE_GENE:
+			printf("gene %u\t%u\t%g\n", e->a, e->b, e->value);
+			break;
+		case TRACE_REPLACE:
+			printf("replace %u\tindividual %u\n", e->a, e->b);
+			break;
+		default:
+			printf("event %u\t%u %u %u %g\n", e->type, e->a, e->b, e->c, e->value);
+			break;
+	}
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+typedef struct
+{
+	trace_chunk_t header;
+	trace_event_t events[TRACE_CHUNK_EVENTS];
+} trace_buffer_t;
+
+static FILE* trace_file = NULL;
+static unsigned int trace_threads = 0;
+static pthread_key_t buffer_key;
+static pthread_once_t buffer_once = PTHREAD_ONCE_INIT;
+static __thread trace_buffer_t* buffer = NULL;
+
+// Local functions
+static void create_key(void);
+static void flush(trace_buffer_t* b);
+static void release(void* b);
+
+int trace_open(const char* path)
+{
+	static int registered = 0;
+
+	if(path == NULL || trace_file != NULL)
+		return -1;
+
+	trace_file = fopen(path, "wb");
+	if(trace_file == NULL)
+		return -1;
+
+	if(!registered && atexit(&trace_close) == 0)
+		registered = 1;
+
+	return 0;
+}
+
+void trace_close(void)
+{
+	if(trace_file == NULL)
+		return;
+
+	if(buffer != NULL)
+		flush(buffer);
+	fclose(trace_file);
+	trace_file = NULL;
+}
+
+void trace_record(unsigned int type, unsigned int a, unsigned int b, unsigned int c, double value)
+{
+	trace_event_t* e;
+
+	if(trace_file == NULL)
+		return;
+
+	// Buffer of this thread, written out when the thread exits
+	if(buffer == NULL)
+	{
+		pthread_once(&buffer_once, &create_key);
+		buffer = (trace_buffer_t*)malloc(sizeof(trace_buffer_t));
+		if(buffer == NULL)
+			return;
+		buffer->header.magic = TRACE_MAGIC;
+		buffer->header.thread = __sync_fetch_and_add(&trace_threads, 1);
+		buffer->header.count = 0;
+		buffer->header.reserved = 0;
+		pthread_setspecific(buffer_key, buffer);
+	}
+
+	e = &buffer->events[ buffer->header.count++ ];
+	e->type  = type;
+	e->a     = a;
+	e->b     = b;
+	e->c     = c;
+	e->value = value;
+
+	if(buffer->header.count == TRACE_CHUNK_EVENTS)
+		flush(buffer);
+}
+
+static void create_key(void)
+{
+	pthread_key_create(&buffer_key, &release);
+}
+
+/* Write the buffer as one chunk. Chunks of different threads don't interleave. */
+static void flush(trace_buffer_t* b)
+{
+	if(b->header.count == 0 || trace_file == NULL)
+		return;
+
+	flockfile(trace_file);
+	fwrite(&b->header, sizeof(trace_chunk_t), 1, trace_file);
+	fwrite(b->events, sizeof(trace_event_t), b->header.count, trace_file);
+	funlockfile(trace_file);
+
+	b->header.count = 0;
+}
+
+/* Thread exit */
+static void release(void* b)
+{
+	flush((trace_buffer_t*)b);
+	free(b);
+}
@@ -0,0 +1,73 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/*
+ * Binary event tracing. Events are recorded if their level is at most
+ * TRACE_LEVEL, set at compile time (make TRACE_LEVEL=3), and at most the
+ * run-time level passed to TRACE() (micro_ga_config_t.debug). With the
+ * default TRACE_LEVEL of 0 every TRACE() compiles to nothing.
+ *
+ * Each thread collects its events in its own buffer, written to the trace
+ * file as one chunk when full, when the thread exits and at trace_close().
+ * trace-decode prints a trace file as text.
+ */
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL		0
+#endif
+
+/* Levels */
+#define TRACE_LEVEL_GENERATION	1	/// Once per generation
+#define TRACE_LEVEL_INDIVIDUAL	2	/// Per individual and child
+#define TRACE_LEVEL_GENE		3	/// Per gene
+
+/* Events */
+#define TRACE_GENERATION	1	/// a = generation, b = # replaced, c = fittest, value = its fitness
+#define TRACE_EVALUATE		2	/// a = individual, value = fitness
+#define TRACE_PARENTS		3	/// a = child, b = mother, c = father
+#define TRACE_CHILD			4	/// a = child, b = first changed gene, c = genome hash
+#define TRACE_GENE			5	/// a = child, b = gene, value = gene
+#define TRACE_REPLACE		6	/// a = child, b = individual it replaces
+
+#define TRACE_MAGIC			0x45435254U	/// "TRCE", starts every chunk
+#define TRACE_CHUNK_EVENTS	4096		/// Events per thread buffer
+
+typedef struct
+{
+	unsigned int type;
+	unsigned int a;
+	unsigned int b;
+	unsigned int c;
+	double value;
+} trace_event_t;
+
+/* Chunk of one thread's events, followed by count trace_event_t */
+typedef struct
+{
+	unsigned int magic;
+	unsigned int thread;			/// Threads are numbered in order of their first event
+	unsigned int count;
+	unsigned int reserved;
+} trace_chunk_t;
+
+#define TRACE(run_level, level, type, a, b, c, value) \
+	do { \
+		if((level) <= TRACE_LEVEL && (level) <= (run_level)) \
+			trace_record((type), (a), (b), (c), (value)); \
+	} while(0)
+
+/**
+ *  Start writing events to a trace file. The file is closed at exit.
+ *
+ *  @param path
+ *  @return 0 = success, -1 = failure (file can't be created or already open)
+ */
+int trace_open(const char* path);
+
+/* Write the calling thread's events and close the trace file */
+void trace_close(void);
+
+/* Record an event, dropped while no trace file is open */
+void trace_record(unsigned int type, unsigned int a, unsigned int b, unsigned int c, double value);
+
+#endif